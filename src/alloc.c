@@ -0,0 +1,242 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * alloc.c - dynamic memory allocation functions
+ *
+ * Besides the malloc() wrappers, arenas hand out the large input and output
+ * buffers. An arena maps its blocks straight from the kernel and allocates
+ * from them by bumping an offset; nothing is freed on its own, the whole
+ * arena is reset once a job (a file of a batch, a conversion of a watched
+ * file) is done. Blocks a job needed on top of the first are merged in a
+ * single one at reset time, so a steady workload ends up allocating from one
+ * block without ever calling the kernel. The blocks can be backed by huge
+ * pages, to save TLB misses on inputs of hundreds of megabytes.
+ *
+ * Under a memory limit, each of the MEMORY_POOLS pools of buffers (reader
+ * blocks, pipeline buffers, encoder outputs, and the remaining emitter and
+ * output buffers) is sized to a share of it. The pools are fixed, so a
+ * producer waits for buffers to be handed back rather than allocating more.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "include/alloc.h"
+
+#define ARENA_ALIGN         64              /* allocations alignment */
+#define ARENA_PAGE_SIZE     4096
+#define ARENA_HUGE_SIZE     (2 << 20)       /* huge page size */
+
+/* header at the start of every block, padded to ARENA_ALIGN */
+#define ARENA_HEADER    ((sizeof(struct arena_block) + ARENA_ALIGN - 1) & \
+                         ~(size_t)(ARENA_ALIGN - 1))
+
+static int huge_pages;
+static size_t memory_limit;     /* zero for none */
+
+char * allocate_dynamic_memory(size_t alloc_size)
+{
+    /* use malloc() to allocate dynamic memory and then return to the caller
+     * function the memory location allocated on the heap.
+     */
+    char *ptr = malloc(alloc_size);
+
+    /* error handling: on errors malloc() returns NULL. */
+    if (ptr == NULL) {
+        printf("%zu byte(s) memory allocation error.", alloc_size);
+        exit(EXIT_FAILURE);
+    }
+
+    return ptr;
+}
+
+char * change_dynamic_memory(char *ptr, size_t new_size)
+{
+    /* call to realloc() to change the size of the memory block pointed to by
+     * the pointer 'ptr' with the new size value in 'new_size'.
+     */
+    char *new_ptr = realloc(ptr, new_size);
+
+    /* error handling: on errors realloc() returns NULL. */
+    if (new_ptr == NULL) {
+        printf("%zu byte(s) memory re-allocation error.", new_size);
+        exit(EXIT_FAILURE);
+    }
+
+    return new_ptr;
+}
+
+void set_huge_pages(int enabled)
+{
+    huge_pages = enabled;
+}
+
+void set_memory_limit(size_t limit)
+{
+    memory_limit = limit;
+}
+
+size_t memory_budget(size_t wanted)
+{
+    /* the share of the limit a pool of buffers may use */
+    if (memory_limit != 0 && wanted > memory_limit / MEMORY_POOLS)
+        return memory_limit / MEMORY_POOLS;
+    return wanted;
+}
+
+int memory_exceeded(size_t size)
+{
+    /* buffers holding a whole input may use all of the limit */
+    return memory_limit != 0 && size > memory_limit;
+}
+
+static size_t block_rounding(void)
+{
+    return huge_pages ? ARENA_HUGE_SIZE : ARENA_PAGE_SIZE;
+}
+
+static void arena_error(size_t size)
+{
+    printf("%zu byte(s) memory allocation error.", size);
+    exit(EXIT_FAILURE);
+}
+
+static struct arena_block * map_block(size_t size)
+{
+    struct arena_block *b = MAP_FAILED;
+
+    size = (size + block_rounding() - 1) & ~(block_rounding() - 1);
+
+    /* reserved huge pages first, then transparent ones if there's none */
+    if (huge_pages)
+        b = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (b == MAP_FAILED) {
+        b = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (b == MAP_FAILED)
+            arena_error(size);
+        if (huge_pages)
+            madvise(b, size, MADV_HUGEPAGE);
+    }
+
+    b->next = NULL;
+    b->size = size;
+    b->used = ARENA_HEADER;
+    return b;
+}
+
+void arena_init(struct arena *a, size_t block_size)
+{
+    a->block = NULL;
+    a->block_size = block_size;
+    a->last = NULL;
+}
+
+void * arena_alloc(struct arena *a, size_t size)
+{
+    struct arena_block *b = a->block;
+    char *ptr;
+
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    /* a new block when the current one is full, the old one is kept until
+     * the arena is reset.
+     */
+    if (b == NULL || b->size - b->used < size) {
+        b = map_block((size > a->block_size ? size : a->block_size) +
+                      ARENA_HEADER);
+        b->next = a->block;
+        a->block = b;
+    }
+
+    ptr = (char *)b + b->used;
+    b->used += size;
+    a->last = ptr;
+    return ptr;
+}
+
+void * arena_grow(struct arena *a, void *ptr, size_t old_size,
+                  size_t new_size)
+{
+    struct arena_block *b = a->block, *moved;
+    size_t end, size;
+    char *new_ptr;
+
+    if (ptr == NULL)
+        return arena_alloc(a, new_size);
+
+    if (ptr == a->last) {
+        /* the last allocation grows in place while its block has room */
+        end = (char *)ptr - (char *)b +
+              ((new_size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1));
+        if (end <= b->size) {
+            b->used = end;
+            return ptr;
+        }
+
+        /* a block holding nothing else is remapped larger, without a copy */
+        size = (end + block_rounding() - 1) & ~(block_rounding() - 1);
+        if ((char *)ptr - (char *)b == ARENA_HEADER &&
+            (moved = mremap(b, b->size, size, MREMAP_MAYMOVE)) != MAP_FAILED) {
+            moved->size = size;
+            moved->used = end;
+            a->block = moved;
+            a->last = (char *)moved + ARENA_HEADER;
+            return a->last;
+        }
+    }
+
+    new_ptr = arena_alloc(a, new_size);
+    memcpy(new_ptr, ptr, old_size);
+    return new_ptr;
+}
+
+void arena_reset(struct arena *a)
+{
+    struct arena_block *b, *next;
+    size_t total = 0;
+
+    /* the blocks of a job that didn't fit in one are merged */
+    if (a->block != NULL && a->block->next != NULL) {
+        for (b = a->block; b != NULL; b = next) {
+            next = b->next;
+            total += b->size;
+            munmap(b, b->size);
+        }
+        a->block = map_block(total);
+    }
+    if (a->block != NULL)
+        a->block->used = ARENA_HEADER;
+    a->last = NULL;
+}
+
+void arena_release(struct arena *a)
+{
+    struct arena_block *b, *next;
+
+    for (b = a->block; b != NULL; b = next) {
+        next = b->next;
+        munmap(b, b->size);
+    }
+    a->block = NULL;
+    a->last = NULL;
+}
@@ -22,15 +22,107 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <getopt.h>
 #include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/stat.h>
 #include "include/bool.h"
 #include "include/version.h"
+#include "include/alloc.h"
+#include "include/emit.h"
+#include "include/input.h"
+#include "include/strscan.h"
+#include "include/entropy.h"
+#include "include/thread.h"
+#include "include/search.h"
+#include "include/elfparse.h"
+#include "include/dumpfmt.h"
+#include "include/hexcodec.h"
+#include "include/reader.h"
+#include "include/output.h"
+#include "include/hash.h"
+#include "include/watch.h"
+#include "include/cache.h"
+#include "include/decompress.h"
+#include "include/pipeline.h"
+#include "include/incbin.h"
+#include "include/procmem.h"
+#include "include/sparse.h"
+#include "include/checksum.h"
+#include "include/json.h"
 
-#define BADCHAR_HEX_SEQLEN  510     /* badchar hex digits sequence length */
+#define BADCHAR_BLOCK_SIZE  (1 << 20) /* badchar rounds encoded at once */
 #define MAX_FILENAME_LENGTH 512     /* max filename length on filesystems */
 #define MAX_ARGUMENT_LENGTH 255     /* max length of option's argument */
+#define ENTROPY_BAR_LENGTH  32      /* width of the entropy map bar graph */
+#define ENTROPY_DOMINANT_SHARE 0.0625 /* share of a window's dominant byte */
+#define WATCH_BLOCK_SIZE    4096    /* input bytes per watched block hash */
+#define MAX_SYNTAX_TARGETS  8       /* --syntax options with their output */
+#define FANOUT_BLOCK_SIZE   (4 << 20) /* input bytes fed to every emitter */
+#define PROCMEM_BLOCK_SIZE  (4 << 20) /* process memory read at once */
 
+/* how the files of a batch are laid out in the output */
+#define BATCH_STRINGS       0       /* a binary string per file */
+#define BATCH_CONCAT        1       /* a single binary string */
+#define BATCH_ARRAYS        2       /* an array per file, named after it */
+
+/* getopt_long() return values of the long-only options */
+enum {
+    OPT_STRINGS = 256,
+    OPT_ENTROPY,
+    OPT_WINDOW,
+    OPT_STEP,
+    OPT_THREADS,
+    OPT_SEARCH,
+    OPT_PATTERNS,
+    OPT_SECTION,
+    OPT_SYMBOL,
+    OPT_INPUT_FORMAT,
+    OPT_RAW,
+    OPT_OUTPUT,
+    OPT_WATCH,
+    OPT_CACHE,
+    OPT_CACHE_SIZE,
+    OPT_NO_DECOMPRESS,
+    OPT_LINE,
+    OPT_HUGE_PAGES,
+    OPT_PIPELINE,
+    OPT_EXCLUDE,
+    OPT_RANGE,
+    OPT_REVERSE,
+    OPT_ROUNDS,
+    OPT_INCBIN,
+    OPT_PID,
+    OPT_ADDRESS,
+    OPT_LENGTH,
+    OPT_ZERO_RUNS,
+    OPT_RUNS,
+    OPT_CHECKSUM,
+    OPT_JSON,
+    OPT_CONCAT,
+    OPT_ARRAYS,
+    OPT_MAX_MEMORY,
+};
+
+
+/* bad character sequence options */
+struct badchar_options {
+    unsigned char excluded[256];    /* bytes left out of the sequence */
+    int first;                  /* first byte of the range */
+    int last;                   /* last byte of the range */
+    bool reverse;               /* from the last byte to the first */
+    unsigned long rounds;       /* number of times the sequence is output */
+};
+
+/* an output syntax, and the file it is written to (stdout if NULL) */
+struct syntax_target {
+    int lang;
+    char *filename;
+    FILE *stream;
+    struct emitter em;
+};
 
 /* declare the 'verbose_flag' global integer */
 static int verbose_flag;
@@ -39,17 +131,65 @@ static int interactive_flag;
 
 static void print_usage(FILE *stream, char *program_name)
 {
-    fprintf(stream, "Usage: %s [OPTION]...\n", program_name);
+    fprintf(stream, "Usage: %s [OPTION]... [FILE]...\n", program_name);
     fprintf(stream, " Convert input to specified binary string format.\n\n");
     fprintf(stream, " At least one of the below options must be given:\n\
     -D, --dump-file=FILE    Dump content of file FILE in hexadecimal format\n\
     -x, --hex-escape        Escape input hexadecimal string\n\
     -b, --gen-badchar       Generate a bad character sequence string\n\
+       --strings[=ENC]      Extract printable strings (ascii, utf16le, all)\n\
+       --entropy            Output a byte entropy map of the input\n\
+       --search=PATTERN     Search hex PATTERN, '?' matches any nibble\n\
+       --patterns=FILE      Search patterns read from FILE, one per line\n\
     \n");
     fprintf(stream, " The below switches are optional:\n\
     -f, --file=FILE         Read input from file FILE instead of stdin\n\
+                            (files after -D or -f are converted in batch)\n\
     -w, --width=bytes       Break binary strings to specified length in bytes\n\
-    -s, --syntax=LANG       Syntax of the binary string output\n\
+    -s, --syntax=LANG       Syntax of the binary string output: c, python,\n\
+                            decimal (list of byte values) or raw\n\
+    -s, --syntax=LANG:FILE  Also write -x output in LANG syntax to FILE\n\
+                            (may be given several times, one pass)\n\
+       --input-format=FMT   Format of -x input: auto (default), hex, xxd,\n\
+                            hexdump (-C), objdump (-d) or gdb (x/x)\n\
+       --raw                Output decoded -x input as raw bytes\n\
+       --line               Convert -x standard input line by line\n\
+       --output=FILE        Write -D, -x -D or -b output to file FILE\n\
+       --pid=PID            List the memory regions of process PID\n\
+       --address=ADDRESS    Dump process memory at hex ADDRESS, up to the\n\
+                            end of its region unless --length is given\n\
+       --length=SIZE        Number of process memory bytes to dump\n\
+       --zero-runs[=SIZE]   Output runs of SIZE zero bytes or more of the -D\n\
+                            file as * ranges or -x statements (default 4K)\n\
+       --runs[=SIZE]        Output runs of SIZE repeated bytes or more of\n\
+                            the -D file as * ranges or -x statements (64)\n\
+       --checksum=LIST      Output crc32, crc32c and/or sha256 checksums\n\
+                            of the -D files, such as crc32,sha256\n\
+       --json               Output -D or -x -f files as NDJSON records of\n\
+                            hex chunks, and of their sizes and checksums\n\
+       --concat             Output the input files as a single string\n\
+       --arrays             Output -x input files as arrays named after\n\
+                            them, with their lengths\n\
+       --incbin=NAME        Write input bytes to NAME.bin, and NAME.S and\n\
+                            NAME.h assembler source and header for it\n\
+                            (no --syntax)\n\
+       --watch              Update the --output file when the -D file changes\n\
+       --cache=DIR          Keep -x outputs in DIR, reuse them if unchanged\n\
+       --cache-size=SIZE    Cache size limit (default 256M)\n\
+       --no-decompress      Read gzip, xz or zstd input files as they are\n\
+    -n, --min-length=N      Minimum length of extracted strings (default 4)\n\
+       --exclude=BYTES      Leave hex BYTES out of -b, such as 00,0a,20-2f\n\
+       --range=FIRST-LAST   Range of the -b sequence (default 01-ff)\n\
+       --reverse            Output the -b sequence from its last byte\n\
+       --rounds=N           Output the -b sequence N times\n\
+       --section=NAME       Dump only ELF section NAME of the -D file\n\
+       --symbol=NAME        Dump only ELF symbol NAME of the -D file\n\
+       --window=SIZE        Entropy map window size (default 4K)\n\
+       --step=SIZE          Entropy map window step (default window size)\n\
+       --threads=N          Number of worker threads (default CPU count)\n\
+       --huge-pages         Back input and output buffers with huge pages\n\
+       --pipeline           Read, encode and write -D or -f files in threads\n\
+       --max-memory=SIZE    Keep input and output buffers within SIZE bytes\n\
     -h, --help              Display this help\n\
        --interactive        Enter interactive mode\n\
        --verbose            Enable verbose output\n\
@@ -81,291 +221,1571 @@ static void print_version(FILE *stream, char *program_name)
     fprintf(stream, "For help enter \"%s --help\"\n", program_name);
 }
 
-void output_hex_escaped_string(char *ptr_char_array, int *array_size,
-                               int *output_lang, int string_width)
+static void emit_dump_bytes(void *ctx, const unsigned char *data,
+                            size_t len)
 {
-    /* declare integer i and c */
-    int i, c;
+    /* bytes extracted from a textual dump go straight to the emitter */
+    emit_bytes((struct emitter *)ctx, data, len);
+}
 
-    /* initialize the hex escaped character array index to zero.
-     * it keep track of the number of hex digits present in the binary string.
-     */
-    int ai = 0;
+void output_hex_escaped_string(char *ptr_char_array, int *array_size,
+                               int *output_lang, int string_width,
+                               int input_format)
+{
+    /* declare the syntax emitter writing the binary string to stdout */
+    struct emitter em;
 
-    /* initialize integer 'invalidhexchar' to be used as a counter. */
-    int invalidhexchar = 0;
+    /* recognize textual dumps (xxd, hexdump -C, objdump -d, gdb) */
+    if (input_format == DUMP_AUTO) {
+        input_format = detect_dump_format(ptr_char_array, *array_size);
+        if (verbose_flag == true && input_format != DUMP_PLAIN)
+            printf("[+] Input detected as %s output.\n",
+                   dump_format_name(input_format));
+    }
 
     /* if interactive flag set, start the binary string on a new line */
     if (interactive_flag)
         putchar('\n');
 
+    emit_init(&em, *output_lang, string_width);
+
     /* if verbose flag set, we output variable names */
-    if (verbose_flag) {
-        switch (*output_lang) {
-            case 1: printf("unsigned char buffer[] =\n"); break;
-            case 2: printf("buffer =  \"\"\n"); break;
+    if (verbose_flag)
+        emit_declaration(&em);
+
+    /* escape every pair of hexadecimal digits of the character array, any
+     * other characters are filtered out by the emitter. the byte columns of
+     * textual dumps are extracted by their parser instead.
+     */
+    if (input_format == DUMP_PLAIN)
+        emit_hex_text(&em, ptr_char_array, *array_size);
+    else
+        parse_dump(input_format, ptr_char_array, *array_size,
+                   emit_dump_bytes, &em);
+
+    /* we've reached the end of the binary string output. */
+    emit_end(&em);
+
+    if ((verbose_flag == true) && (em.invalid > 0)) {
+        fprintf(stdout, "[-] Warning: %lu non-hexadecimal character(s) "
+                        "detected in input.\n", em.invalid);
+    }
+
+    emit_free(&em);
+}
+
+void output_hex_escaped_lines(int *output_lang, int string_width,
+                              int input_format)
+{
+    struct emitter em;
+    struct dump_parser dp;
+    char *line = NULL, *held = NULL;
+    size_t capacity = 0, held_len = 0;
+    ssize_t len;
+
+    if (interactive_flag)
+        printf("[+] Lines are converted as they are entered, hit CTRL-D to "
+               "terminate input.\n");
+
+    emit_init(&em, *output_lang, string_width);
+
+    if (verbose_flag)
+        emit_declaration(&em);
+
+    dump_parser_init(&dp, input_format, emit_dump_bytes, &em);
+
+    /* the emitter and the dump parser keep their state from one input line
+     * to the next, only the output is flushed after each of them.
+     */
+    while ((len = getline(&line, &capacity, stdin)) != -1) {
+        if (input_format != DUMP_AUTO) {
+            if (input_format == DUMP_PLAIN)
+                emit_hex_text(&em, line, len);
+            else
+                dump_parser_feed(&dp, line, len);
+            emit_flush(&em);
+            fflush(stdout);
+            continue;
+        }
+
+        /* lines are held until the first ones tell the input format */
+        held = change_dynamic_memory(held, held_len + len);
+        memcpy(held + held_len, line, len);
+        held_len += len;
+        input_format = detect_dump_format_prefix(held, held_len);
+        if (input_format == DUMP_AUTO)
+            continue;
+        if (verbose_flag == true && input_format != DUMP_PLAIN) {
+            emit_flush(&em);
+            printf("[+] Input detected as %s output.\n",
+                   dump_format_name(input_format));
         }
+        dp.format = input_format;
+        if (input_format == DUMP_PLAIN)
+            emit_hex_text(&em, held, held_len);
+        else
+            dump_parser_feed(&dp, held, held_len);
+        emit_flush(&em);
+        fflush(stdout);
+    }
+
+    /* the input ended before its format could be told */
+    if (input_format == DUMP_AUTO && held_len > 0) {
+        dp.format = detect_dump_format(held, held_len);
+        if (verbose_flag == true && dp.format != DUMP_PLAIN) {
+            emit_flush(&em);
+            printf("[+] Input detected as %s output.\n",
+                   dump_format_name(dp.format));
+        }
+        if (dp.format == DUMP_PLAIN)
+            emit_hex_text(&em, held, held_len);
+        else
+            dump_parser_feed(&dp, held, held_len);
+    }
+
+    emit_end(&em);
+
+    if ((verbose_flag == true) && (em.invalid > 0)) {
+        fprintf(stdout, "[-] Warning: %lu non-hexadecimal character(s) "
+                        "detected in input.\n", em.invalid);
+    }
+
+    emit_free(&em);
+    free(held);
+    free(line);
+}
+
+static void emit_dump_raw(void *ctx, const unsigned char *data, size_t len)
+{
+    /* bytes extracted from a textual dump are output as they are */
+    emit_write((struct emitter *)ctx, (const char *)data, len);
+}
+
+static void warn_hex_input(bool raw, unsigned long invalid, int nibble)
+{
+    /* the same diagnostics whether the output was converted or cached */
+    if (verbose_flag == true && raw == true && nibble != 0)
+        fprintf(stderr, "[-] Warning: odd number of hexadecimal digits, "
+                        "last digit ignored.\n");
+    if (verbose_flag == true && invalid > 0)
+        fprintf(stdout, "[-] Warning: %lu non-hexadecimal character(s) "
+                        "detected in input.\n", invalid);
+}
+
+void output_hex_escaped_input(char *filename, bool binary, bool raw,
+                              int *output_lang, int string_width,
+                              int input_format, int nthreads,
+                              struct cache *cache)
+{
+    struct input_map map;
+    struct emitter em;
+    struct output out;
+    unsigned long long key;
+    char params[256];
+    int n;
+
+    /* map the whole input in memory, a NULL filename reads stdin */
+    map_input(filename, &map);
+
+    /* recognize textual dumps (xxd, hexdump -C, objdump -d, gdb) */
+    if (binary == false && input_format == DUMP_AUTO) {
+        input_format = detect_dump_format((char *)map.data, map.size);
+        if (verbose_flag == true && input_format != DUMP_PLAIN)
+            printf("[+] Input detected as %s output.\n",
+                   dump_format_name(input_format));
     }
 
-    /* for every character of the character array 'char_array'
-    * loop through the body until we reach the end of the array.
-    */
-    for (i = 0; i < *array_size; i++) {
-        /* initialize c to the i(th) element of the array */
-        c = ptr_char_array[i];
+    /* the output only depends on the input content and on these options,
+     * a cached output for the same key is sent as it is.
+     */
+    n = snprintf(params, sizeof(params), "%s -x %d %d %d %d %d %d %zu",
+                 program_version, binary, raw, *output_lang, string_width,
+                 input_format, verbose_flag, map.size);
+    key = cache->dir != NULL ? hash64(params, n, hash64(map.data, map.size,
+                                                        0)) : 0;
+    if (cache_lookup(cache, key)) {
+        if (verbose_flag == true && raw == false)
+            printf("[+] Output cache hit (%lu hit(s), %lu miss(es)).\n",
+                   cache->hits, cache->misses);
+        cache_send(cache, stdout);
+        warn_hex_input(raw, cache->invalid, cache->nibble);
+        unmap_input(&map);
+        return;
+    }
+    if (verbose_flag == true && raw == false && cache->dir != NULL)
+        printf("[+] Output cache miss (%lu hit(s), %lu miss(es)).\n",
+               cache->hits, cache->misses);
 
-        /* filter out any characters outside of the hexadecimal ASCII character
-         * range.
+    /* formatted buffers are spliced if the output is a pipe */
+    emit_init(&em, *output_lang, string_width);
+    output_open(&out, stdout);
+    output_attach(&out, &em);
+    cache_record(cache, &em);
+
+    if (raw == true) {
+        /* decoded bytes go to the output as they are */
+        if (binary == true)
+            emit_write(&em, (const char *)map.data, map.size);
+        else if (input_format == DUMP_PLAIN)
+            decode_hex_text(&em, (const char *)map.data, map.size,
+                            nthreads);
+        else
+            parse_dump(input_format, (const char *)map.data, map.size,
+                       emit_dump_raw, &em);
+    } else {
+        /* if verbose flag set, we output variable names */
+        if (verbose_flag == true)
+            emit_declaration(&em);
+        /* files and plain hex digits are converted by parallel workers,
+         * textual dumps by their line parser.
          */
-        switch (c) {
-            /* if the character is within the hexadecimal characters range.
-             * ranges within switch case's constants are supported by GCC.
+        if (binary == true)
+            encode_bytes(&em, map.data, map.size, nthreads);
+        else if (input_format == DUMP_PLAIN)
+            encode_hex_text(&em, (const char *)map.data, map.size, nthreads);
+        else
+            parse_dump(input_format, (const char *)map.data, map.size,
+                       emit_dump_bytes, &em);
+        emit_end(&em);
+    }
+    cache_commit(cache);
+    output_close(&out);
+    emit_free(&em);
+
+    warn_hex_input(raw, em.invalid, em.nibble);
+    unmap_input(&map);
+}
+
+static void emit_dump_targets(void *ctx, const unsigned char *data,
+                              size_t len)
+{
+    struct syntax_target *targets = ctx;
+    int i;
+
+    /* bytes parsed once from a textual dump go to every emitter */
+    for (i = 0; i < MAX_SYNTAX_TARGETS && targets[i].stream != NULL; i++)
+        emit_bytes(&targets[i].em, data, len);
+}
+
+/* bytes decoded from a block of hexadecimal text, for every target */
+struct decoded_block {
+    unsigned char *data;
+    size_t len;
+};
+
+static void decoded_block_append(void *ctx, const char *data, size_t len)
+{
+    struct decoded_block *db = ctx;
+
+    /* a block of text decodes to at most half of its size */
+    memcpy(db->data + db->len, data, len);
+    db->len += len;
+}
+
+void output_byte_runs(char *filename, bool escaped, int *output_lang,
+                      int string_width, size_t min_run, bool any_byte,
+                      int nthreads)
+{
+    struct input_map map;
+    struct run_scanner rs;
+    struct byte_run run;
+    struct emitter em;
+    struct output out;
+    unsigned long long bytes = 0;
+    unsigned long runs = 0;
+    size_t pos = 0;
+
+    map_input(filename, &map);
+    run_scanner_init(&rs, &map, min_run, any_byte);
+
+    emit_init(&em, escaped ? *output_lang : SYNTAX_RAW,
+              escaped ? string_width : 0);
+    output_open(&out, stdout);
+    output_attach(&out, &em);
+    /* if verbose flag set, we output variable names. C always needs one
+     * to fill the runs in.
+     */
+    if (escaped == true && (verbose_flag == true || em.lang == SYNTAX_C))
+        emit_sized_declaration(&em, map.size);
+
+    /* the bytes between runs are encoded as usual */
+    while (pos < map.size) {
+        next_byte_run(&rs, pos, &run);
+        if (run.start > pos && escaped == true) {
+            emit_segment_begin(&em, pos);
+            encode_bytes(&em, map.data + pos, run.start - pos, nthreads);
+            emit_segment_end(&em);
+        } else if (run.start > pos) {
+            emit_hex_digits(&em, map.data + pos, run.start - pos);
+        }
+        if (run.end > run.start) {
+            if (escaped == true) {
+                emit_byte_run(&em, run.start, run.byte, run.end - run.start);
+            } else {
+                if (run.start > pos)
+                    emit_write(&em, "\n", 1);
+                emit_run_marker(&em, run.start, run.end, run.byte);
+            }
+            bytes += run.end - run.start;
+            runs++;
+        }
+        pos = run.end;
+    }
+
+    /* an empty input still gets an empty binary string. plain hexadecimal
+     * digits end as they are.
+     */
+    if (escaped == true && map.size == 0) {
+        emit_segment_begin(&em, 0);
+        emit_segment_end(&em);
+    }
+    output_close(&out);
+    emit_free(&em);
+
+    if (verbose_flag == true)
+        printf("[+] %llu byte(s) in %lu run(s), %llu of them in holes.\n",
+               bytes, runs, rs.holes);
+    unmap_input(&map);
+}
+
+void output_hex_escaped_targets(char *filename, bool binary,
+                                struct syntax_target *targets, int ntargets,
+                                int string_width, int input_format,
+                                int nthreads)
+{
+    struct input_map map;
+    struct output out;
+    struct emitter dec;
+    struct decoded_block block;
+    char digit[2];
+    size_t pos, n;
+    int i;
+
+    /* the input is read and its format recognized once for all targets */
+    map_input(filename, &map);
+    if (binary == false && input_format == DUMP_AUTO) {
+        input_format = detect_dump_format((char *)map.data, map.size);
+        if (verbose_flag == true && input_format != DUMP_PLAIN)
+            printf("[+] Input detected as %s output.\n",
+                   dump_format_name(input_format));
+    }
+
+    output_open(&out, stdout);
+    for (i = 0; i < ntargets; i++) {
+        struct syntax_target *t = &targets[i];
+
+        emit_init(&t->em, t->lang, string_width);
+        if (t->filename == NULL) {
+            t->stream = stdout;
+            output_attach(&out, &t->em);
+        } else {
+            t->stream = fopen(t->filename, "w");
+            if (t->stream == NULL) {
+                printf("Error: output filename \"%s\" cannot be "
+                       "written.\n", t->filename);
+                exit(EXIT_FAILURE);
+            }
+            t->em.ctx = t->stream;
+            if (verbose_flag == true)
+                printf("[+] Writing output to \"%s\".\n", t->filename);
+        }
+    }
+    for (i = 0; i < ntargets; i++) {
+        /* if verbose flag set, we output variable names */
+        if (verbose_flag == true)
+            emit_declaration(&targets[i].em);
+    }
+
+    /* blocks of the input are fed to every emitter in turn, while they are
+     * still in the cache. hexadecimal text is validated and decoded once
+     * per block, textual dumps are parsed a single time.
+     */
+    emit_init(&dec, SYNTAX_RAW, 0);
+    dec.flush = decoded_block_append;
+    dec.ctx = &block;
+    block.data = NULL;
+    if (binary == false && input_format == DUMP_PLAIN)
+        block.data = (unsigned char *)allocate_dynamic_memory(
+                         FANOUT_BLOCK_SIZE / 2);
+    if (binary == true || input_format == DUMP_PLAIN) {
+        for (pos = 0; pos < map.size; pos += n) {
+            n = map.size - pos < FANOUT_BLOCK_SIZE ? map.size - pos
+                                                   : FANOUT_BLOCK_SIZE;
+            if (binary == true) {
+                for (i = 0; i < ntargets; i++)
+                    encode_bytes(&targets[i].em, map.data + pos, n,
+                                 nthreads);
+                continue;
+            }
+            block.len = 0;
+            decode_hex_text(&dec, (const char *)map.data + pos, n,
+                            nthreads);
+            for (i = 0; i < ntargets; i++)
+                encode_bytes(&targets[i].em, block.data, block.len,
+                             nthreads);
+        }
+    } else {
+        parse_dump(input_format, (const char *)map.data, map.size,
+                   emit_dump_targets, targets);
+    }
+
+    /* we've reached the end of the binary string outputs. a lone trailing
+     * digit is output as it is, as when the text is escaped directly.
+     */
+    snprintf(digit, sizeof(digit), "%x", dec.digit);
+    for (i = 0; i < ntargets; i++) {
+        if (dec.nibble != 0)
+            emit_hex_text(&targets[i].em, digit, 1);
+        emit_end(&targets[i].em);
+    }
+    if (verbose_flag == true && dec.invalid > 0) {
+        printf("[-] Warning: %lu non-hexadecimal character(s) "
+               "detected in input.\n", dec.invalid);
+    }
+    emit_free(&dec);
+    free(block.data);
+    for (i = 0; i < ntargets; i++) {
+        struct syntax_target *t = &targets[i];
+
+        emit_free(&t->em);
+        if (t->stream != stdout && fclose(t->stream) != 0) {
+            printf("Error: output filename \"%s\" cannot be written.\n",
+                   t->filename);
+            exit(EXIT_FAILURE);
+        }
+    }
+    output_close(&out);
+    unmap_input(&map);
+}
+
+static void emit_message(struct emitter *em, FILE *stream,
+                         const char *fmt, ...)
+{
+    char message[1024];
+    va_list ap;
+    int n;
+
+    /* messages to stdout are put in the output of the emitter, which may be
+     * written by another thread.
+     */
+    emit_flush(em);
+    va_start(ap, fmt);
+    if (stream == stdout) {
+        n = vsnprintf(message, sizeof(message), fmt, ap);
+        if (n > 0)
+            emit_write(em, message, (size_t)n < sizeof(message) ? n :
+                                    sizeof(message) - 1);
+    } else {
+        vfprintf(stream, fmt, ap);
+    }
+    va_end(ap);
+}
+
+static void emit_checksums(struct emitter *em, struct checksums *cs,
+                           const char *filename, bool comments)
+{
+    char text[CHECKSUM_TEXT_SIZE];
+    int kind;
+
+    /* as comments following the binary string, or on the standard error
+     * if they would end up in a hexadecimal string.
+     */
+    checksums_final(cs);
+    for (kind = CHECKSUM_CRC32; kind <= CHECKSUM_SHA256; kind <<= 1) {
+        if ((cs->kinds & kind) == 0)
+            continue;
+        checksum_format(cs, kind, text);
+        if (comments == true)
+            emit_comment(em, "%s %s", checksum_name(kind), text);
+        else
+            fprintf(stderr, "[+] %s of \"%s\": %s\n", checksum_name(kind),
+                    filename, text);
+    }
+}
+
+/* keywords of the array syntaxes, C up to C23 and Python */
+static const char *keywords[] = {
+    "alignas", "alignof", "asm", "auto", "bool", "break", "case", "char",
+    "const", "constexpr", "continue", "default", "do", "double", "else",
+    "enum", "extern", "false", "float", "for", "goto", "if", "inline", "int",
+    "long", "nullptr", "register", "restrict", "return", "short", "signed",
+    "sizeof", "static", "static_assert", "struct", "switch", "thread_local",
+    "true", "typedef", "typeof", "typeof_unqual", "union", "unsigned",
+    "void", "volatile", "while",
+    "False", "None", "True", "and", "as", "assert", "async", "await",
+    "class", "def", "del", "elif", "except", "finally", "from", "global",
+    "import", "in", "is", "lambda", "nonlocal", "not", "or", "pass", "raise",
+    "try", "with", "yield",
+    NULL
+};
+
+/* tells whether 'name' is the length variable of array 'array' */
+static bool is_length_of(const char *name, const char *array)
+{
+    size_t len = strlen(array);
+
+    return strncmp(name, array, len) == 0 && strcmp(name + len, "_len") == 0;
+}
+
+static bool array_name_taken(char (*names)[INCBIN_SYMBOL_LENGTH], int count,
+                             const char *name)
+{
+    int i;
+
+    for (i = 0; keywords[i] != NULL; i++) {
+        if (strcmp(name, keywords[i]) == 0)
+            return true;
+    }
+    /* neither an earlier array nor its length variable */
+    for (i = 0; i < count; i++) {
+        if (strcmp(name, names[i]) == 0 || is_length_of(name, names[i]) ||
+            is_length_of(names[i], name))
+            return true;
+    }
+    return false;
+}
+
+static void array_name(const char *filename,
+                       char (*names)[INCBIN_SYMBOL_LENGTH], int count)
+{
+    char base[INCBIN_SYMBOL_LENGTH], symbol[INCBIN_SYMBOL_LENGTH];
+    const char *slash = strrchr(filename, '/');
+    char *dot, *name = names[count];
+    int suffix = 1;
+
+    /* the file name without its directory nor its extension, as an
+     * identifier: "payloads/stage1.bin" is named "stage1".
+     */
+    snprintf(base, sizeof(base), "%s", slash != NULL ? slash + 1 : filename);
+    dot = strrchr(base, '.');
+    if (dot != NULL && dot != base)
+        *dot = '\0';
+    incbin_symbol(base, symbol, sizeof(symbol) - 4);
+
+    /* identifiers starting with an underscore are reserved at file scope
+     * in C, such names get a prefix. keywords and names already given get
+     * a numeric suffix: a second "stage1" array is named "stage1_2".
+     */
+    strcpy(name, symbol[0] == '_' ? "data" : "");
+    strcat(name, symbol);
+    strcpy(symbol, name);
+    while (array_name_taken(names, count, name))
+        snprintf(name, INCBIN_SYMBOL_LENGTH, "%.*s_%d",
+                 INCBIN_SYMBOL_LENGTH - 16, symbol, ++suffix);
+}
+
+static void hold_text(struct arena *a, char **text, size_t *len,
+                      size_t *size, const char *data, size_t n,
+                      const char *filename)
+{
+    /* a line cut by the end of a block, kept until the next one */
+    if (*len + n > *size) {
+        if (memory_exceeded(2 * (*len + n))) {
+            printf("Error: a line of \"%s\" is larger than the memory "
+                   "limit.\n", filename);
+            exit(EXIT_FAILURE);
+        }
+        *text = arena_grow(a, *text, *len, 2 * (*len + n));
+        *size = 2 * (*len + n);
+    }
+    memcpy(*text + *len, data, n);
+    *len += n;
+}
+
+/* the decoded bytes of a file in --json mode, and where its records go */
+struct json_payload {
+    struct emitter *out;
+    const char *filename;
+    unsigned long long offset;
+    struct checksums *cs;
+};
+
+static void json_payload_write(void *ctx, const char *data, size_t len)
+{
+    struct json_payload *jp = ctx;
+    const unsigned char *bytes = (const unsigned char *)data;
+    struct json_record r;
+
+    /* a chunk record for each buffer of decoded bytes */
+    checksums_update(jp->cs, bytes, len);
+    json_begin(&r, jp->out);
+    json_string(&r, "type", "chunk");
+    json_string(&r, "path", jp->filename);
+    json_number(&r, "offset", jp->offset);
+    json_hex(&r, "hex", bytes, len);
+    json_end(&r);
+    jp->offset += len;
+}
+
+static void emit_json_file(struct json_payload *jp, const char *format,
+                           unsigned long invalid, bool odd)
+{
+    char text[CHECKSUM_TEXT_SIZE];
+    struct json_record r;
+    int kind;
+
+    /* the file record follows all of its chunk records */
+    checksums_final(jp->cs);
+    json_begin(&r, jp->out);
+    json_string(&r, "type", "file");
+    json_string(&r, "path", jp->filename);
+    json_string(&r, "format", format);
+    json_number(&r, "size", jp->offset);
+    json_number(&r, "invalid", invalid);
+    json_bool(&r, "odd_digit", odd);
+    for (kind = CHECKSUM_CRC32; kind <= CHECKSUM_SHA256; kind <<= 1) {
+        if ((jp->cs->kinds & kind) == 0)
+            continue;
+        checksum_format(jp->cs, kind, text);
+        json_string(&r, checksum_name(kind), text);
+    }
+    json_end(&r);
+}
+
+void output_hex_files(char **filenames, int nfiles, bool escaped,
+                      bool binary, bool raw, int *output_lang,
+                      int string_width, int input_format, int nthreads,
+                      bool pipelined, int checksum_kinds, bool json,
+                      int layout)
+{
+    char (*names)[INCBIN_SYMBOL_LENGTH] = NULL;
+    unsigned long long *starts = NULL, nbytes = 0;
+    FILE *messages;
+    struct checksums cs;
+    struct reader rd;
+    struct reader_block blk;
+    struct emitter em, jem;
+    struct json_payload jp;
+    struct output out;
+    struct pipeline pl;
+    struct dump_parser dp;
+    int format = input_format;
+    /* textual dumps are parsed line by line as their blocks are read, the
+     * end of a line cut by a block is held in an arena until the next one.
+     */
+    struct arena files_arena;
+    char *text = NULL;
+    size_t text_len = 0, text_size = 0, head, tail;
+    const char *nl;
+
+    /* blocks of the next files are read while the current one is encoded */
+    reader_open(&rd, filenames, nfiles);
+    arena_init(&files_arena, ARENA_BLOCK_SIZE);
+    if (verbose_flag == true && (raw == false || json == true)) {
+        fprintf(json ? stderr : stdout, "[+] Reading %d file(s) with "
+                "%s%s.\n", nfiles, reader_engine(&rd), pipelined ?
+                ", reader, encoder and writer threads pipelined" : "");
+    }
+
+    emit_init(&em, escaped ? *output_lang : SYNTAX_RAW,
+              escaped ? string_width : 0);
+    output_open(&out, stdout);
+    /* in --json mode, files are decoded as in --raw mode and their bytes
+     * are written as records by another emitter.
+     */
+    if (json == true) {
+        emit_init(&jem, SYNTAX_RAW, 0);
+        output_attach(&out, &jem);
+        jp.out = &jem;
+        jp.cs = &cs;
+        em.flush = json_payload_write;
+        em.ctx = &jp;
+        raw = true;
+    /* reads and writes run in threads of their own, this one encodes */
+    } else if (pipelined == true) {
+        pipeline_open(&pl, &rd, &out, &em);
+    } else {
+        output_attach(&out, &em);
+    }
+    /* messages can't be put in the middle of a concatenated string */
+    messages = raw == true || layout == BATCH_CONCAT ? stderr : stdout;
+    if (layout == BATCH_CONCAT)
+        starts = (unsigned long long *)allocate_dynamic_memory(
+            sizeof(*starts) * nfiles);
+    if (layout == BATCH_ARRAYS)
+        names = (char (*)[INCBIN_SYMBOL_LENGTH])allocate_dynamic_memory(
+            sizeof(*names) * nfiles);
+
+    while (pipelined == true ? pipeline_next(&pl, &blk)
+                             : reader_next(&rd, &blk)) {
+        /* first block of a file: name it, and recognize textual dumps */
+        if (blk.offset == 0) {
+            format = input_format;
+            if (binary == false && format == DUMP_AUTO) {
+                format = detect_dump_format((const char *)blk.data,
+                                            blk.len);
+                if (verbose_flag == true && format != DUMP_PLAIN)
+                    emit_message(&em, messages, "[+] Input \"%s\" "
+                                 "detected as %s output.\n",
+                                 filenames[blk.file],
+                                 dump_format_name(format));
+            }
+            if (binary == false && format != DUMP_PLAIN)
+                dump_parser_init(&dp, format,
+                                 raw ? emit_dump_raw : emit_dump_bytes, &em);
+            checksums_init(&cs, checksum_kinds);
+            jp.filename = filenames[blk.file];
+            jp.offset = 0;
+            if (layout == BATCH_ARRAYS) {
+                /* an array named after the file, declared in any case */
+                array_name(filenames[blk.file], names, blk.file);
+                em.name = names[blk.file];
+                emit_declaration(&em);
+            } else if (layout == BATCH_CONCAT) {
+                /* the files are segments of a single binary string */
+                starts[blk.file] = binary ? nbytes : em.count;
+                if (blk.file == 0 && escaped == true && verbose_flag == true)
+                    emit_declaration(&em);
+            } else {
+                if (nfiles > 1 && raw == false)
+                    emit_comment(&em, "%s", filenames[blk.file]);
+                if (escaped == true && raw == false && verbose_flag == true)
+                    emit_declaration(&em);
+            }
+        }
+
+        if (binary == true) {
+            nbytes += blk.len;
+            /* checksums of the block while it is in the cache */
+            if (checksum_kinds != 0 && json == false)
+                checksums_update(&cs, blk.data, blk.len);
+            if (raw == true)
+                emit_write(&em, (const char *)blk.data, blk.len);
+            else if (escaped == true)
+                encode_bytes(&em, blk.data, blk.len, nthreads);
+            else
+                emit_hex_digits(&em, blk.data, blk.len);
+        } else if (format == DUMP_PLAIN) {
+            if (raw == true)
+                decode_hex_text(&em, (const char *)blk.data, blk.len,
+                                nthreads);
+            else
+                encode_hex_text(&em, (const char *)blk.data, blk.len,
+                                nthreads);
+        } else {
+            /* the whole lines of the block, up to its last line feed, are
+             * parsed. the held line, if any, is completed and parsed first.
              */
-            case 48 ... 57:         // 0-9
-            case 65 ... 70:         // A-F
-            case 97 ... 102:        // a-f
-                /* if the hex escaped char array index is divible by two,
-                 * we've pair of hexadecimal characters (or byte), we need to
-                 * escape using the binary string escape characters '\' and
-                 * 'x' respectively.
-                 */
-                if (ai % 2 == 0) {
-                    /* if string_width is non-default or specified. */
-                    if (string_width != 0) {
-                        /* if true, we are at the end of the line.
-                         * ensure integer 'ai' is non-zero so we don't insert
-                         * a new line character in the first row of output.
-                         * put a new line character every string_width's byte
-                         * value.
-                         */
-                        if (ai % (string_width*2) == 0) {
-                            switch (*output_lang) {
-                                case 1:     /* C Syntax */
-                                    if (ai != 0) { putchar('\"'); }
-                                    if (ai != 0) { putchar('\n'); }
-                                    putchar('\"');
-                                    break;
-                                case 2:     /* Python Syntax */
-                                    if (ai != 0) { putchar('\"'); }
-                                    if (ai != 0) { putchar('\n'); }
-                                    printf("buffer += ");
-                                    putchar('\"');
-                                    break;
-                                default:
-                                    if (ai != 0) { putchar('\n'); }
-                           }
-                        }
-                    }
-                    putchar('\\');
-                    putchar('x');
-                    putchar(c);
-                } else {
-                    putchar(c);
-                }
-                /* Increase the hex escaped character array index so we keep
-                 * track of the pair of hexadecimal byte inside the binary
-                 * string.
-                 */
-                ai++;
-                break;
-            default:        /* all non-hexadecimal characters */
-                /* catches all non-hexadcimal characters, excepted the
-                 * end-of-file, the new-line and the null characters
-                 * respectively.
-                 */
-                switch (c) {
-                    case EOF: break;    // End of File
-                    case 10: break;     // New Line
-                    case 0: break;      // Null
-                    default: invalidhexchar++;
-                }
+            tail = blk.len;
+            while (blk.last == 0 && tail > 0 && blk.data[tail-1] != '\n')
+                tail--;
+            head = 0;
+            if (text_len > 0 && tail > 0) {
+                nl = memchr(blk.data, '\n', tail);
+                head = nl != NULL ? nl + 1 - (const char *)blk.data : tail;
+                hold_text(&files_arena, &text, &text_len, &text_size,
+                          (const char *)blk.data, head, filenames[blk.file]);
+                dump_parser_feed(&dp, text, text_len);
+                arena_reset(&files_arena);
+                text = NULL;
+                text_len = 0;
+                text_size = 0;
+            }
+            if (tail > head)
+                dump_parser_feed(&dp, (const char *)blk.data + head,
+                                 tail - head);
+            hold_text(&files_arena, &text, &text_len, &text_size,
+                      (const char *)blk.data + tail, blk.len - tail,
+                      filenames[blk.file]);
+        }
+
+        if (blk.last == 0)
+            continue;
+
+        /* last block of a file: terminate its binary string */
+        if (json == true) {
+            emit_flush(&em);
+            emit_json_file(&jp, binary ? "binary" : dump_format_name(format),
+                           em.invalid, em.nibble != 0);
+            em.nibble = 0;
+        } else if (raw == true) {
+            if (verbose_flag == true && em.nibble != 0)
+                fprintf(stderr, "[-] Warning: odd number of hexadecimal "
+                        "digits in \"%s\", last digit ignored.\n",
+                        filenames[blk.file]);
+            em.nibble = 0;
+        } else if (layout == BATCH_ARRAYS) {
+            emit_array_end(&em);
+        } else if (layout == BATCH_CONCAT) {
+            /* the string ends with the last file, followed by the offsets
+             * and lengths of its segments.
+             */
+            if (blk.file == nfiles - 1) {
+                unsigned long long end = binary ? nbytes : em.count;
+                int i;
+
+                emit_end(&em);
+                for (i = 0; i < nfiles; i++)
+                    emit_comment(&em, "%s: offset 0x%llx, %llu byte(s)",
+                                 filenames[i], starts[i],
+                                 (i + 1 < nfiles ? starts[i+1] : end) -
+                                 starts[i]);
+            }
+        } else if (escaped == true || nfiles > 1) {
+            emit_end(&em);
+        }
+        if (checksum_kinds != 0 && json == false)
+            emit_checksums(&em, &cs, filenames[blk.file],
+                           escaped == true || nfiles > 1);
+        if (verbose_flag == true && em.invalid > 0)
+            emit_message(&em, messages, "[-] Warning: %lu "
+                         "non-hexadecimal character(s) detected in "
+                         "\"%s\".\n", em.invalid, filenames[blk.file]);
+        em.invalid = 0;
+    }
+
+    if (pipelined == true && json == false)
+        pipeline_close(&pl);
+    output_close(&out);
+    if (json == true)
+        emit_free(&jem);
+    emit_free(&em);
+    free(starts);
+    free(names);
+    arena_release(&files_arena);
+    reader_close(&rd);
+}
+
+static const char * parse_byte_range(const char *s, int *first, int *last)
+{
+    unsigned long value;
+    char *end;
+
+    /* a hex byte "xx", or a range of them "xx-yy" */
+    value = strtoul(s, &end, 16);
+    if (end == s || value > 0xff)
+        return NULL;
+    *first = *last = value;
+    if (*end == '-') {
+        s = end + 1;
+        value = strtoul(s, &end, 16);
+        if (end == s || value > 0xff || (int)value < *first)
+            return NULL;
+        *last = value;
+    }
+    return end;
+}
+
+/* tells whether the 'len' first characters of 'arg' are syntax 'name' */
+static bool syntax_is(const char *arg, size_t len, const char *name)
+{
+    return strlen(name) == len && strncmp(arg, name, len) == 0;
+}
+
+static bool parse_byte_set(const char *s, unsigned char *set)
+{
+    int first, last;
+
+    /* comma separated bytes and ranges */
+    for (;;) {
+        s = parse_byte_range(s, &first, &last);
+        if (s == NULL)
+            return false;
+        while (first <= last)
+            set[first++] = 1;
+        if (*s == '\0')
+            return true;
+        if (*s++ != ',')
+            return false;
+    }
+}
+
+size_t generate_badchar_sequence(const struct badchar_options *opts,
+                                 unsigned char *sequence)
+{
+    size_t n = 0;
+    int i;
+
+    /* the bytes of the range, minus the excluded ones, in either order */
+    for (i = opts->first; i <= opts->last; i++) {
+        if (opts->excluded[i] == 0)
+            sequence[n++] = i;
+    }
+    if (opts->reverse == true) {
+        for (i = 0; i < (int)n / 2; i++) {
+            unsigned char c = sequence[i];
+
+            sequence[i] = sequence[n-1-i];
+            sequence[n-1-i] = c;
         }
     }
+    return n;
+}
+
+char * read_and_store_char_input(int *array_size)
+{
+    /* declare integer 'c' which will hold input character. */
+    int c;
+    /* initialize integer 'i' which will be used as an array index. */
+    int i = 0;
+
+    /* if in interactive mode */
+    if (interactive_flag)
+        printf("[+] Hit CTRL-D twice to terminate input.\n");
+
+    /* initialize character array pointer 'ptr_char_array' by calling
+     * allocate_dynamic_memory() function.
+     */
+    char *ptr_char_array = allocate_dynamic_memory(sizeof(char));
+
+    /* store each input character into the character array 'ptr_char_array'
+     * until we reach EOF.
+     */
+    while ((c = getchar()) != EOF) {
+        ptr_char_array[i] = (char)c;
+        ptr_char_array = change_dynamic_memory(ptr_char_array, sizeof(char) *
+                                              (*array_size+=1));
+        i++;
+    }
+    /* null-terminate the extra array element */
+    ptr_char_array[i] = '\0';
+
+    /* return a pointer to caller function */
+    return ptr_char_array;
+}
+
+/* output context shared by the printable strings hit callback */
+struct strings_output {
+    struct emitter *em;         /* escaped output emitter, NULL if plain */
+    int tag;                    /* tag strings with their encoding */
+    unsigned long hits;         /* number of strings found */
+};
+
+static void output_string_hit(void *ctx, unsigned long long offset,
+                              const unsigned char *data, size_t len,
+                              int encoding)
+{
+    struct strings_output *so = ctx;
+    size_t i;
+
+    so->hits++;
+
+    /* escaped output: a comment holding the offset followed by the bytes of
+     * the string, as they appear in the input.
+     */
+    if (so->em != NULL) {
+        emit_comment(so->em, "offset 0x%08llx, %zu byte(s), %s", offset, len,
+                     encoding == STRSCAN_ASCII ? "ascii" : "utf-16le");
+        emit_bytes(so->em, data, len);
+        emit_end(so->em);
+        return;
+    }
+
+    /* plain output: offset in hexadecimal followed by the string */
+    printf("%08llx ", offset);
+    if (so->tag)
+        printf("%c ", encoding == STRSCAN_ASCII ? 's' : 'l');
+    if (encoding == STRSCAN_ASCII) {
+        fwrite(data, sizeof(char), len, stdout);
+    } else {
+        /* narrow UTF-16LE characters by skipping their null high bytes */
+        for (i = 0; i < len; i += 2)
+            putchar_unlocked(data[i]);
+    }
+    putchar_unlocked('\n');
+}
+
+void output_printable_strings(char *filename, int encodings,
+                              size_t min_length, bool escaped,
+                              int *output_lang, int string_width)
+{
+    struct input_map map;
+    struct emitter em;
+    struct strings_output so = { NULL, 0, 0 };
+    struct strscan scan;
+
+    /* map the whole input in memory, a NULL filename reads stdin */
+    map_input(filename, &map);
+
+    if (escaped == true) {
+        emit_init(&em, *output_lang, string_width);
+        so.em = &em;
+    }
+    so.tag = (encodings == (STRSCAN_ASCII | STRSCAN_UTF16LE));
+
+    scan.encodings = encodings;
+    scan.min_length = min_length;
+    scan.hit = output_string_hit;
+    scan.ctx = &so;
+    scan_printable_strings(map.data, map.size, &scan);
+
+    if (so.em != NULL)
+        emit_free(&em);
+    fflush(stdout);
+
+    if (verbose_flag == true)
+        printf("[+] %lu string(s) found in %zu byte(s) of input.\n", so.hits,
+               map.size);
+
+    unmap_input(&map);
+}
+
+void output_to_file(char *output_filename, const unsigned char *data,
+                    size_t len, bool escaped, int *output_lang,
+                    int string_width, int nthreads)
+{
+    struct output_file out;
+    int flags = escaped ? 0 : ENCODE_PLAIN_HEX;
+    size_t size;
+
+    /* if verbose flag set, we output variable names */
+    if (escaped == true && verbose_flag == true)
+        flags |= ENCODE_DECLARATION;
+
+    /* the output size only depends on the input length, the file is
+     * allocated and mapped once, then workers format their chunk in place.
+     */
+    size = encoded_size(*output_lang, string_width, flags, len);
+    output_file_create(&out, output_filename, size);
+    if (verbose_flag == true) {
+        printf("[+] Writing %zu byte(s) to \"%s\" with %d thread(s).\n",
+               size, output_filename, nthreads);
+    }
+    encode_bytes_in_place(out.data, *output_lang, string_width, flags, data,
+                          len, 0, len, nthreads);
+    output_file_close(&out);
+}
+
+void output_badchar_sequence(const struct badchar_options *opts,
+                             char *output_filename, int *output_lang,
+                             int string_width, int nthreads)
+{
+    unsigned char sequence[256], *block;
+    size_t n, rounds_per_block, i;
+    unsigned long rounds;
+    struct emitter em;
+    struct output out;
+    FILE *stream = stdout;
+
+    n = generate_badchar_sequence(opts, sequence);
+    if (verbose_flag == true) {
+        printf("[+] %zu bad character(s) between 0x%02x and 0x%02x, %lu "
+               "round(s).\n", n, opts->first, opts->last, opts->rounds);
+    }
+    if (opts->rounds > SIZE_MAX / n) {
+        printf("Error: %lu rounds of %zu byte(s) are too large an "
+               "output.\n", opts->rounds, n);
+        exit(EXIT_FAILURE);
+    }
+
+    /* every round is the same, a block of whole rounds is generated once
+     * and encoded as many times as needed, to the output file as well.
+     */
+    rounds_per_block = BADCHAR_BLOCK_SIZE / n;
+    if (rounds_per_block > opts->rounds)
+        rounds_per_block = opts->rounds;
+    block = (unsigned char *)allocate_dynamic_memory(n * rounds_per_block +
+                                                     1);
+    for (i = 0; i < rounds_per_block; i++)
+        memcpy(block + i * n, sequence, n);
+
+    if (output_filename != NULL) {
+        stream = fopen(output_filename, "w");
+        if (stream == NULL) {
+            printf("Error: output filename \"%s\" cannot be written.\n",
+                   output_filename);
+            exit(EXIT_FAILURE);
+        }
+        if (verbose_flag == true)
+            printf("[+] Writing output to \"%s\".\n", output_filename);
+    } else if (interactive_flag) {
+        /* if interactive flag set, start the binary string on a new line */
+        putchar('\n');
+    }
+
+    emit_init(&em, *output_lang, string_width);
+    output_open(&out, stream);
+    output_attach(&out, &em);
+
+    /* if verbose flag set, we output variable names */
+    if (verbose_flag)
+        emit_declaration(&em);
+
+    for (rounds = opts->rounds; rounds > 0; ) {
+        i = rounds < rounds_per_block ? rounds : rounds_per_block;
+        encode_bytes(&em, block, n * i, nthreads);
+        rounds -= i;
+    }
 
     /* we've reached the end of the binary string output. */
-    switch (*output_lang) {
-        case 1: putchar('\"'); break;
-        case 2: putchar('\"'); break;
+    emit_end(&em);
+    output_close(&out);
+    emit_free(&em);
+    free(block);
+    if (stream != stdout && fclose(stream) != 0) {
+        printf("Error: output filename \"%s\" cannot be written.\n",
+               output_filename);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void dump_to_file(char *filename, char *output_filename, bool escaped,
+                  int *output_lang, int string_width, int nthreads)
+{
+    struct input_map map;
+
+    map_input(filename, &map);
+    output_to_file(output_filename, map.data, map.size, escaped,
+                   output_lang, string_width, nthreads);
+    unmap_input(&map);
+}
+
+void watch_dump_file(char *filename, char *output_filename, bool escaped,
+                     int *output_lang, int string_width, int nthreads)
+{
+    struct watch w;
+    struct stat st;
+    struct input_map map;
+    struct output_file out;
+    unsigned long long *hashes = NULL, h;
+    size_t len = 0, nblocks = 0, i, first, changed;
+    int flags = escaped ? 0 : ENCODE_PLAIN_HEX;
+    bool converted = false;
+
+    /* if verbose flag set, we output variable names */
+    if (escaped == true && verbose_flag == true)
+        flags |= ENCODE_DECLARATION;
+
+    /* the watch starts before the first conversion, changes made in the
+     * meantime aren't missed.
+     */
+    watch_open(&w, filename);
+
+    for (;; watch_wait(&w)) {
+        /* the file may be missing while it's being replaced */
+        if (stat(filename, &st) != 0)
+            continue;
+        map_input(filename, &map);
+
+        if (converted == false || map.size != len) {
+            /* new length: the output is created again, at its new size */
+            if (converted == true)
+                output_file_close(&out);
+            len = map.size;
+            nblocks = (len + WATCH_BLOCK_SIZE - 1) / WATCH_BLOCK_SIZE;
+            hashes = (unsigned long long *)change_dynamic_memory(
+                         (char *)hashes, sizeof(*hashes) * (nblocks + 1));
+            for (i = 0; i < nblocks; i++)
+                hashes[i] = hash64(map.data + i * WATCH_BLOCK_SIZE,
+                                   len - i * WATCH_BLOCK_SIZE <
+                                   WATCH_BLOCK_SIZE ? len - i *
+                                   WATCH_BLOCK_SIZE : WATCH_BLOCK_SIZE, 0);
+            output_file_create(&out, output_filename,
+                               encoded_size(*output_lang, string_width,
+                                            flags, len));
+            encode_bytes_in_place(out.data, *output_lang, string_width,
+                                  flags, map.data, len, 0, len, nthreads);
+            converted = true;
+            if (verbose_flag == true) {
+                printf("[+] \"%s\" converted to \"%s\" (%zu byte(s)).\n",
+                       filename, output_filename, out.size);
+                fflush(stdout);
+            }
+            unmap_input(&map);
+            continue;
+        }
+
+        /* same length: only runs of blocks whose hash changed are encoded
+         * again, over their previous output.
+         */
+        changed = 0;
+        for (i = 0; i < nblocks;) {
+            for (first = i; i < nblocks; i++) {
+                size_t n = len - i * WATCH_BLOCK_SIZE < WATCH_BLOCK_SIZE ?
+                           len - i * WATCH_BLOCK_SIZE : WATCH_BLOCK_SIZE;
+
+                h = hash64(map.data + i * WATCH_BLOCK_SIZE, n, 0);
+                if (h == hashes[i])
+                    break;
+                hashes[i] = h;
+            }
+            if (i > first) {
+                encode_bytes_in_place(out.data, *output_lang, string_width,
+                                      flags, map.data, len,
+                                      first * WATCH_BLOCK_SIZE,
+                                      i * WATCH_BLOCK_SIZE, nthreads);
+                changed += i - first;
+            } else {
+                i++;
+            }
+        }
+        if (verbose_flag == true) {
+            printf("[+] \"%s\" changed: %zu of %zu block(s) encoded "
+                   "again.\n", filename, changed, nblocks);
+            fflush(stdout);
+        }
+        unmap_input(&map);
+    }
+}
+
+static void find_elf_range(const struct input_map *map, char *filename,
+                           char *section, char *symbol,
+                           struct elf_range *range)
+{
+    int error;
+
+    if (section != NULL)
+        error = elf_find_section(map->data, map->size, section, range);
+    else
+        error = elf_find_symbol(map->data, map->size, symbol, range);
+    if (error < 0) {
+        printf("Error: %s \"%s\" of \"%s\": %s.\n",
+               section != NULL ? "section" : "symbol",
+               section != NULL ? section : symbol, filename,
+               elf_strerror(error));
+        exit(EXIT_FAILURE);
+    }
+}
+
+void dump_elf_range(char *filename, char *section, char *symbol,
+                    bool escaped, char *output_filename, int *output_lang,
+                    int string_width, int nthreads)
+{
+    struct input_map map;
+    struct elf_range range;
+    struct emitter em;
+
+    /* map the file and locate the section or symbol in place, without
+     * extracting it first.
+     */
+    map_input(filename, &map);
+    find_elf_range(&map, filename, section, symbol, &range);
+
+    if (verbose_flag == true) {
+        printf("[+] Dumping %s %s: %llu byte(s) at offset 0x%llx.\n",
+               section != NULL ? "section" : "symbol",
+               section != NULL ? section : symbol, range.size, range.offset);
+    }
+
+    /* same output as a full dump, restricted to the range */
+    if (output_filename != NULL) {
+        output_to_file(output_filename, map.data + range.offset, range.size,
+                       escaped, output_lang, string_width, nthreads);
+        unmap_input(&map);
+        return;
+    }
+    emit_init(&em, *output_lang, string_width);
+    if (escaped == true) {
+        if (verbose_flag == true)
+            emit_declaration(&em);
+        emit_bytes(&em, map.data + range.offset, range.size);
+        emit_end(&em);
+    } else {
+        emit_hex_digits(&em, map.data + range.offset, range.size);
+    }
+    emit_free(&em);
+
+    unmap_input(&map);
+}
+
+void output_incbin(char *filename, bool binary, int input_format,
+                   char *section, char *symbol, char *base, int nthreads)
+{
+    struct input_map map;
+    struct elf_range range;
+    struct emitter em;
+    char binary_filename[MAX_FILENAME_LENGTH];
+    FILE *fp;
+    long long size;
+
+    /* the raw bytes of the input are written to BASE.bin, decoded from
+     * hexadecimal text or dumps in -x mode.
+     */
+    snprintf(binary_filename, sizeof(binary_filename), "%s.bin", base);
+    fp = fopen(binary_filename, "w");
+    if (fp == NULL) {
+        printf("Error: output filename \"%s\" cannot be written.\n",
+               binary_filename);
+        exit(EXIT_FAILURE);
+    }
+
+    map_input(filename, &map);
+    range.offset = 0;
+    range.size = map.size;
+    if (binary == true && (section != NULL || symbol != NULL))
+        find_elf_range(&map, filename, section, symbol, &range);
+    if (binary == false && input_format == DUMP_AUTO) {
+        input_format = detect_dump_format((char *)map.data, map.size);
+        if (verbose_flag == true && input_format != DUMP_PLAIN)
+            printf("[+] Input detected as %s output.\n",
+                   dump_format_name(input_format));
     }
-    putchar('\n');
 
-    if ((verbose_flag == true) && (invalidhexchar > 0)) {
-        fprintf(stdout, "[-] Warning: %d non-hexadecimal character(s) "
-                        "detected in input.\n", invalidhexchar);
+    emit_init(&em, SYNTAX_RAW, 0);
+    em.ctx = fp;
+    if (binary == true)
+        emit_write(&em, (const char *)map.data + range.offset, range.size);
+    else if (input_format == DUMP_PLAIN)
+        decode_hex_text(&em, (const char *)map.data, map.size, nthreads);
+    else
+        parse_dump(input_format, (const char *)map.data, map.size,
+                   emit_dump_raw, &em);
+    if (verbose_flag == true && em.nibble != 0)
+        printf("[-] Warning: odd number of hexadecimal digits, last digit "
+               "ignored.\n");
+    emit_free(&em);
+    unmap_input(&map);
+
+    size = ftello(fp);
+    if (size < 0 || fclose(fp) != 0) {
+        printf("Error: output filename \"%s\" cannot be written.\n",
+               binary_filename);
+        exit(EXIT_FAILURE);
     }
+
+    /* the assembler source including it and the C header declaring it */
+    write_incbin_sources(base, binary_filename, size);
+    if (verbose_flag == true)
+        printf("[+] Wrote %lld byte(s) to \"%s\", with \"%s.S\" and "
+               "\"%s.h\".\n", size, binary_filename, base, base);
 }
 
-char * allocate_dynamic_memory(int alloc_size)
+void list_process_regions(pid_t pid)
 {
-    /* use malloc() to allocate dynamic memory and then return to the caller
-     * function the memory location allocated on the heap.
-     */
-    char *ptr = malloc(alloc_size);
+    struct proc_region region;
+    FILE *maps;
 
-    /* error handling: on errors malloc() returns NULL. */
-    if (ptr == NULL) {
-        printf("%d byte(s) memory allocation error.", alloc_size);
+    maps = proc_open_maps(pid);
+    if (maps == NULL) {
+        printf("Error: process %d regions cannot be read: %s.\n", (int)pid,
+               strerror(errno));
         exit(EXIT_FAILURE);
     }
-
-    return ptr;
+    /* one region per line, sized, with the file it maps if any */
+    while (proc_next_region(maps, &region)) {
+        printf("%016llx-%016llx %s %10llu %s\n", region.start, region.end,
+               region.perms, region.end - region.start, region.path);
+    }
+    fclose(maps);
 }
 
-char * change_dynamic_memory(char *ptr, int new_size)
+void dump_process_memory(pid_t pid, unsigned long long address,
+                         unsigned long long length, bool escaped,
+                         int *output_lang, int string_width, int nthreads)
 {
-    /* call to realloc() to change the size of the memory block pointed to by
-     * the pointer 'ptr' with the new size value in 'new_size'.
+    struct proc_region region;
+    struct emitter em;
+    struct output out;
+    unsigned char *block;
+    size_t n, done;
+
+    /* without --length, which can't be zero, the region holding the
+     * address is dumped up to its end.
      */
-    char *new_ptr = realloc(ptr, new_size);
+    if (length == 0) {
+        if (proc_find_region(pid, address, &region) < 0) {
+            printf("Error: no region of process %d holds address "
+                   "0x%llx.\n", (int)pid, address);
+            exit(EXIT_FAILURE);
+        }
+        length = region.end - address;
+    }
+    if (verbose_flag == true)
+        printf("[+] Reading %llu byte(s) at 0x%llx of process %d.\n",
+               length, address, (int)pid);
 
-    /* error handling: on errors realloc() returns NULL. */
-    if (new_ptr == NULL) {
-        printf("%d byte(s) memory re-allocation error.", new_size);
-        exit(EXIT_FAILURE);
+    emit_init(&em, escaped ? *output_lang : SYNTAX_RAW,
+              escaped ? string_width : 0);
+    output_open(&out, stdout);
+    output_attach(&out, &em);
+    if (escaped == true && verbose_flag == true)
+        emit_declaration(&em);
+
+    /* blocks are copied from the process, then encoded, so no more than
+     * a block is held at once whatever the length.
+     */
+    block = (unsigned char *)allocate_dynamic_memory(PROCMEM_BLOCK_SIZE);
+    while (length > 0) {
+        n = length < PROCMEM_BLOCK_SIZE ? length : PROCMEM_BLOCK_SIZE;
+        done = proc_read(pid, address, block, n);
+        if (done != n) {
+            printf("Error: process %d memory at 0x%llx cannot be read: "
+                   "%s.\n", (int)pid, address + done, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        if (escaped == true)
+            encode_bytes(&em, block, n, nthreads);
+        else
+            emit_hex_digits(&em, block, n);
+        address += n;
+        length -= n;
     }
+    free(block);
 
-    return new_ptr;
+    /* we've reached the end of the binary string output. */
+    if (escaped == true)
+        emit_end(&em);
+    output_close(&out);
+    emit_free(&em);
 }
 
-char * generate_badchar_sequence()
+static unsigned long long parse_size(const char *arg)
 {
-    /* declare integer i */
-    int i;
-
-    /* initialize bad char. character array pointer by calling
-     * allocate_dynamic_memory() function with a fixed allocation size of 510
-     * bytes, the latter being the length we need to hold all hex digits.
-    */
-    char *ptr_badchar_array = allocate_dynamic_memory(sizeof(char) *
-                                                      BADCHAR_HEX_SEQLEN);
-
-    /* initialize length integer */
-    int length = 0;
+    /* parse a size in bytes with an optional K, M or G binary suffix.
+     * strtoull() would wrap negative sizes around, they are rejected.
+     */
+    const char *digits = arg + strspn(arg, " \t");
+    unsigned long long size;
+    int shift = 0;
+    char *end;
 
-    /* simple linear hex digits generator */
-    for (i = 1; i < 256; i++) {
-        /* leveraging sprintf() to store hexadecimal digits to the character
-         * array. -- To check for buffer overflow condition.
-         */
-        length += sprintf(ptr_badchar_array+length, "%02x", i);
+    errno = 0;
+    size = strtoull(digits, &end, 0);
+    switch (*end) {
+        case 'k': case 'K': shift = 10; end++; break;
+        case 'm': case 'M': shift = 20; end++; break;
+        case 'g': case 'G': shift = 30; end++; break;
+    }
+    if (end == digits || *end != '\0' || *digits == '-' || errno != 0 ||
+        size > (~0ULL >> shift)) {
+        fprintf(stderr, "Error: invalid size \"%s\".\n", arg);
+        exit(EXIT_FAILURE);
     }
 
-    /* return the character array pointer to the caller function */
-    return ptr_badchar_array;
+    return size << shift;
 }
 
-char * read_and_store_char_input(int *array_size)
+void output_entropy_map(char *filename, size_t window, size_t step,
+                        int nthreads)
 {
-    /* declare integer 'c' which will hold input character. */
-    int c;
-    /* initialize integer 'i' which will be used as an array index. */
-    int i = 0;
+    struct input_map map;
+    struct entropy_window *ptr_map;
+    unsigned long long histogram[256];
+    char bar[ENTROPY_BAR_LENGTH+1];
+    size_t nwindows, w;
+    int i, n, top, last_n = -1, last_top = -1;
+    bool squeezed = false;
 
-    /* if in interactive mode */
-    if (interactive_flag)
-        printf("[+] Hit CTRL-D twice to terminate input.\n");
+    /* map the whole input in memory, a NULL filename reads stdin */
+    map_input(filename, &map);
 
-    /* initialize character array pointer 'ptr_char_array' by calling
-     * allocate_dynamic_memory() function.
-     */
-    char *ptr_char_array = allocate_dynamic_memory(sizeof(char));
+    nwindows = entropy_window_count(map.size, window, step);
+    ptr_map = (struct entropy_window *)allocate_dynamic_memory(
+                  sizeof(*ptr_map) * nwindows);
+    compute_entropy_map(map.data, map.size, window, step, nthreads, ptr_map,
+                        verbose_flag ? histogram : NULL);
 
-    /* store each input character into the character array 'ptr_char_array'
-     * until we reach EOF.
+    /* one line per window: offset, entropy in bits per byte, bar graph and
+     * most frequent byte. like hexdump(1), runs of windows with the same bar
+     * graph and top byte are squeezed to a single '*' line. the top byte of
+     * windows without a dominant byte is not significant and is ignored.
      */
-    while ((c = getchar()) != EOF) {
-        ptr_char_array[i] = (char)c;
-        ptr_char_array = change_dynamic_memory(ptr_char_array, sizeof(char) *
-                                              (*array_size+=1));
-        i++;
+    for (w = 0; w < nwindows; w++) {
+        n = (int)(ptr_map[w].entropy * ENTROPY_BAR_LENGTH / 8 + 0.5);
+        top = ptr_map[w].top_share < ENTROPY_DOMINANT_SHARE ? -1 :
+              ptr_map[w].top;
+        if (n == last_n && top == last_top && w != nwindows - 1) {
+            if (squeezed == false)
+                printf("*\n");
+            squeezed = true;
+            continue;
+        }
+        last_n = n;
+        last_top = top;
+        squeezed = false;
+
+        memset(bar, '#', n);
+        memset(bar + n, ' ', ENTROPY_BAR_LENGTH - n);
+        bar[ENTROPY_BAR_LENGTH] = '\0';
+        printf("%08zx  %4.2f  |%s|  0x%02x %3.0f%%\n", w * step,
+               ptr_map[w].entropy, bar, ptr_map[w].top,
+               ptr_map[w].top_share * 100);
     }
 
-    /* return a pointer to caller function */
-    return ptr_char_array;
+    /* whole input statistics and its most frequent bytes */
+    if (verbose_flag == true) {
+        printf("[+] %zu byte(s), entropy %.4f bits per byte.\n", map.size,
+               histogram_entropy(histogram, map.size));
+        for (n = 0; n < 8; n++) {
+            top = -1;
+            for (i = 0; i < 256; i++) {
+                if (histogram[i] > 0 &&
+                    (top < 0 || histogram[i] > histogram[top]))
+                    top = i;
+            }
+            if (top < 0)
+                break;
+            printf("[+] byte 0x%02x: %llu (%.2f%%)\n", top, histogram[top],
+                   100.0 * histogram[top] / map.size);
+            histogram[top] = 0;
+        }
+    }
+
+    free(ptr_map);
+    unmap_input(&map);
 }
 
-char * read_from_file(char *filename, int *array_size, int mode)
+void read_search_patterns(struct searcher *s, char *filename)
 {
-    /* declare integer 'c' */
-    int c;
-    /* declare pointer to FILE 'ptr_file_read' */
-    FILE *ptr_file_read;
-    /* initialize char array pointer 'ptr_char_array' to NULL */
-    char *ptr_char_array = NULL;
+    /* declare 'line' character array and pointer to FILE 'ptr_file_read' */
+    char line[MAX_ARGUMENT_LENGTH+1];
+    FILE *ptr_file_read = fopen(filename, "r");
+    int lineno = 0;
 
-    /* initialize pointer 'ptr_file_read' */
-    ptr_file_read = fopen(filename, "r");
-
-    /* if ptr_file_read is null, return an error and exit */
     if (ptr_file_read == NULL) {
-        printf("Error: input filename \"%s\" cannot be read.\n",
-                filename);
+        printf("Error: patterns filename \"%s\" cannot be read.\n",
+               filename);
         exit(EXIT_FAILURE);
     }
 
-    /* before continuing let see in which mode we're in */
-    /* mode 1+: we read file and store content on the heap */
-    if (mode >= 1) {
-        /* initialize char array index */
-        int i = 0;
+    /* one pattern per line, blank lines and '#' comments are skipped */
+    while (fgets(line, sizeof(line), ptr_file_read) != NULL) {
+        lineno++;
+        line[strcspn(line, "#\r\n")] = '\0';
+        if (line[strspn(line, " \t")] == '\0')
+            continue;
+        if (searcher_add(s, line) < 0) {
+            fprintf(stderr, "Error: invalid pattern at %s:%d.\n", filename,
+                    lineno);
+            exit(EXIT_FAILURE);
+        }
+    }
 
-        /* declare character array 'xc' of size '3' which is enough to hold
-         * two hexadecimal digits + null-termination character.
-         */
-        char xc[3];
+    fclose(ptr_file_read);
+}
 
-        /* initialize character array pointer 'ptr_char_array' by calling
-         * allocate_dynamic_memory() function.
-         */
-        switch (mode) {
-            case 1:
-                ptr_char_array = allocate_dynamic_memory(sizeof(char));
-                break;
-            case 2:
-                ptr_char_array = allocate_dynamic_memory(sizeof(char)*2);
-                *array_size += 1;
-                break;
-        }
+void output_search_hits(char *filename, struct searcher *s, bool escaped,
+                        int *output_lang, int string_width, int nthreads)
+{
+    struct input_map map;
+    struct emitter em;
+    struct search_hit *hits;
+    struct search_pattern *p;
+    size_t i, nhits;
 
-        while ((c = getc(ptr_file_read)) != EOF) {
-            switch (mode) {
-                /* mode 1: we simply store the character in buffer. */
-                case 1:
-                    ptr_char_array[i] = (char)c;
-                    ptr_char_array = change_dynamic_memory(ptr_char_array,
-                                                           sizeof(char) *
-                                                           (*array_size+=1));
-                    i++;
-                    break;
-                /* mode 2: here we use 'snprintf()' to format each read
-                 * character to hexadecimal. As two hex digits equal one byte,
-                 * we must grow our destination character array accordingly.
-                 */
-                case 2:
-                    snprintf(xc, 3, "%02x", c);
-                    ptr_char_array[i] = (char)xc[0];
-                    ptr_char_array[i+1] = (char)xc[1];
-                    ptr_char_array = change_dynamic_memory(ptr_char_array,
-                                                           sizeof(char) *
-                                                           (*array_size+=2));
-                    i+=2;
-                    break;
-            }
+    /* map the whole input in memory, a NULL filename reads stdin */
+    map_input(filename, &map);
+
+    searcher_compile(s);
+    nhits = search_buffer(s, map.data, map.size, nthreads, &hits);
+
+    if (escaped == true)
+        emit_init(&em, *output_lang, string_width);
+
+    /* hits are sorted by offset: output the offset and the matching pattern,
+     * or a comment and the matched bytes as an escaped binary string.
+     */
+    for (i = 0; i < nhits; i++) {
+        p = &s->patterns[hits[i].pattern];
+        if (escaped == true) {
+            emit_comment(&em, "offset 0x%08llx, pattern %s", hits[i].offset,
+                         p->text);
+            emit_bytes(&em, map.data + hits[i].offset, p->len);
+            emit_end(&em);
+        } else {
+            printf("%08llx  %s\n", hits[i].offset, p->text);
         }
-    /* otherwise: we read from file and output to stdout directly */
-    } else {
-        /* get next character from file using getc() until we reach EOF */
-        while ((c = getc(ptr_file_read)) != EOF)
-            printf("%02x", c);
-        /* put new line character after string output */
-        // putchar('\n');
     }
 
-    /* close opened file handler */
-    fclose(ptr_file_read);
+    if (escaped == true)
+        emit_free(&em);
 
-    /* return pointer to 'ptr_char_array' */
-    return ptr_char_array;
+    if (verbose_flag == true)
+        printf("[+] %zu match(es) of %d pattern(s) in %zu byte(s) of "
+               "input.\n", nhits, s->npatterns, map.size);
+
+    free(hits);
+    unmap_input(&map);
 }
 
 int main(int argc, char *argv[])
@@ -376,11 +1796,17 @@ int main(int argc, char *argv[])
     int opt;
 
     /* initialize program's options flags */
-    bool doOutputHexEscapedString, doOutputBadCharString,
-         doHexDumpFile, doReadFromFile, doLimitBinaryStringWidth = false;
+    bool doOutputHexEscapedString = false, doOutputBadCharString = false,
+         doHexDumpFile = false, doReadFromFile = false,
+         doLimitBinaryStringWidth = false, doScanStrings = false;
+
+    /* initialize the first input file name, from -D or -f */
+    char *fread_filename = NULL;
 
-    /* declare 'fread_filename' character array */
-    char fread_filename[MAX_FILENAME_LENGTH+1];
+    /* initialize the list of input files, from -D, -f and arguments */
+    char **input_files = NULL;
+    int ninput_files = 0;
+    int batch_layout = BATCH_STRINGS;
 
     /* declare 'ptr_char_array' character array pointer */
     char *ptr_char_array;
@@ -391,12 +1817,78 @@ int main(int argc, char *argv[])
     /* initialize integer pointer 'ptr_output_lang' */
     int *ptr_out_lang = &output_lang;
 
-    /* declare 'arg_lang' character array */
-    char arg_lang[MAX_ARGUMENT_LENGTH];
+    /* initialize the --syntax outputs, converted in one pass if several */
+    struct syntax_target targets[MAX_SYNTAX_TARGETS] = {{0}};
+    int ntargets = 0;
+    char *syntax_file;
+    size_t lang_len;
+    bool doSyntaxTargets = false;
 
     /* initialite string_width to the default value of zero. */
     int string_width = 0;
 
+    /* initialize printable strings encodings and minimum length */
+    int strings_encodings = STRSCAN_ASCII;
+    size_t strings_min_length = STRSCAN_MIN_LENGTH;
+
+    /* initialize entropy map options and the worker threads count */
+    bool doEntropyMap = false;
+    size_t entropy_window = ENTROPY_WINDOW_SIZE, entropy_step = 0;
+    int nthreads = default_thread_count();
+
+    /* initialize ELF section and symbol names to dump */
+    char *elf_section = NULL, *elf_symbol = NULL;
+
+    /* initialize the -x input format to auto-detection */
+    int input_format = DUMP_AUTO;
+    bool doRawOutput = false;
+    bool doLineInput = false;
+    bool doPipeline = false;
+
+    /* initialize the bad character sequence to the 0x01-0xff range */
+    struct badchar_options badchar;
+    bool doBadcharOptions = false;
+    const char *range_end;
+    char *rounds_end;
+    memset(&badchar, 0, sizeof(badchar));
+    badchar.first = 0x01;
+    badchar.last = 0xff;
+    badchar.rounds = 1;
+
+    /* initialize the output file name, stdout if NULL */
+    char *output_filename = NULL;
+    char *incbin_base = NULL;
+
+    /* initialize the process whose memory is dumped */
+    pid_t proc_pid = 0;
+    unsigned long long proc_address = 0, proc_length = 0;
+    bool doProcAddress = false;
+    bool doProcLength = false;
+    char *pid_end;
+
+    /* initialize the shortest byte run output compactly, none if zero */
+    size_t run_min = 0;
+    bool doByteRuns = false;
+
+    /* initialize the checksums of -D files, CHECKSUM_* flags */
+    int checksum_kinds = 0;
+
+    /* initialize the NDJSON output of -D and -f files */
+    bool doJsonOutput = false;
+    bool doWatchInput = false;
+
+    /* initialize the output cache, disabled unless a directory is given */
+    struct cache cache;
+    char *cache_dir = NULL;
+    unsigned long long cache_size = CACHE_DEFAULT_SIZE;
+
+    /* initialize the buffers memory limit, none if zero */
+    unsigned long long max_memory = 0;
+
+    /* initialize the byte patterns searcher */
+    struct searcher searcher;
+    searcher_init(&searcher);
+
     /* getopt_long()'s long_options struct */
     static struct option long_options[] = {
         /* verbosity flags */
@@ -407,10 +1899,45 @@ int main(int argc, char *argv[])
         {"hex-escape",  no_argument,        NULL, 'x'},
         {"gen-badchar", no_argument,        NULL, 'b'},
         {"dump-file",   required_argument,  NULL, 'D'},
+        {"strings",     optional_argument,  NULL, OPT_STRINGS},
+        {"entropy",     no_argument,        NULL, OPT_ENTROPY},
+        {"search",      required_argument,  NULL, OPT_SEARCH},
+        {"patterns",    required_argument,  NULL, OPT_PATTERNS},
         /* program options */
         {"file",        required_argument,  NULL, 'f'},
         {"width",       required_argument,  NULL, 'w'},
         {"syntax",      required_argument,  NULL, 's'},
+        {"min-length",  required_argument,  NULL, 'n'},
+        {"input-format", required_argument, NULL, OPT_INPUT_FORMAT},
+        {"raw",         no_argument,        NULL, OPT_RAW},
+        {"output",      required_argument,  NULL, OPT_OUTPUT},
+        {"watch",       no_argument,        NULL, OPT_WATCH},
+        {"cache",       required_argument,  NULL, OPT_CACHE},
+        {"cache-size",  required_argument,  NULL, OPT_CACHE_SIZE},
+        {"no-decompress", no_argument,      NULL, OPT_NO_DECOMPRESS},
+        {"line",        no_argument,        NULL, OPT_LINE},
+        {"huge-pages",  no_argument,        NULL, OPT_HUGE_PAGES},
+        {"pipeline",    no_argument,        NULL, OPT_PIPELINE},
+        {"max-memory",  required_argument,  NULL, OPT_MAX_MEMORY},
+        {"exclude",     required_argument,  NULL, OPT_EXCLUDE},
+        {"range",       required_argument,  NULL, OPT_RANGE},
+        {"reverse",     no_argument,        NULL, OPT_REVERSE},
+        {"rounds",      required_argument,  NULL, OPT_ROUNDS},
+        {"incbin",      required_argument,  NULL, OPT_INCBIN},
+        {"pid",         required_argument,  NULL, OPT_PID},
+        {"address",     required_argument,  NULL, OPT_ADDRESS},
+        {"length",      required_argument,  NULL, OPT_LENGTH},
+        {"zero-runs",   optional_argument,  NULL, OPT_ZERO_RUNS},
+        {"runs",        optional_argument,  NULL, OPT_RUNS},
+        {"checksum",    required_argument,  NULL, OPT_CHECKSUM},
+        {"json",        no_argument,        NULL, OPT_JSON},
+        {"concat",      no_argument,        NULL, OPT_CONCAT},
+        {"arrays",      no_argument,        NULL, OPT_ARRAYS},
+        {"section",     required_argument,  NULL, OPT_SECTION},
+        {"symbol",      required_argument,  NULL, OPT_SYMBOL},
+        {"window",      required_argument,  NULL, OPT_WINDOW},
+        {"step",        required_argument,  NULL, OPT_STEP},
+        {"threads",     required_argument,  NULL, OPT_THREADS},
         /* version option */
         {"version",     no_argument,    NULL, '@'},
         /* help option */
@@ -418,8 +1945,13 @@ int main(int argc, char *argv[])
         {0, 0, 0, 0}
     };
 
+    /* -D and -f may be given several times, each file name being an
+     * argument of its own.
+     */
+    input_files = (char **)allocate_dynamic_memory(sizeof(char *) * argc);
+
     /* using getopt_long() from GNU C library to parse command-line options */
-    while ((opt = getopt_long(argc, argv, ":D:xbf:w:s:h",
+    while ((opt = getopt_long(argc, argv, ":D:xbf:w:s:n:h",
                               long_options, NULL)) != -1) {
         switch (opt) {
             /* handle getopt_long() return values */
@@ -445,26 +1977,232 @@ int main(int argc, char *argv[])
             case 'b': doOutputBadCharString = true; break;
             case 'D':   /* dump file content in hex */
                 doHexDumpFile = true;
-                if (optarg != NULL)
-                    snprintf(fread_filename, MAX_FILENAME_LENGTH, "%s",
-                             optarg);
+                input_files[ninput_files++] = optarg;
+                fread_filename = input_files[0];
                 break;
             case 'f':   /* file to read from option */
                 doReadFromFile = true;
-                if (optarg != NULL)
-                    snprintf(fread_filename, MAX_FILENAME_LENGTH, "%s",
-                             optarg);
+                input_files[ninput_files++] = optarg;
+                fread_filename = input_files[0];
                 break;
             case 's':   /* syntax option given */
-                if (optarg != NULL) {
-                    snprintf(arg_lang, MAX_ARGUMENT_LENGTH, "%s", optarg);
+                /* LANG:FILE writes the output in LANG syntax to FILE, LANG
+                 * is compared in place, whatever its length.
+                 */
+                syntax_file = strchr(optarg, ':');
+                lang_len = strlen(optarg);
+                if (syntax_file != NULL) {
+                    lang_len = syntax_file - optarg;
+                    syntax_file++;
+                    doSyntaxTargets = true;
+                }
+                if (syntax_is(optarg, lang_len, "c")) {
+                    output_lang=SYNTAX_C;
+                } else if (syntax_is(optarg, lang_len, "python")) {
+                    output_lang=SYNTAX_PYTHON;
+                } else if (syntax_is(optarg, lang_len, "raw")) {
+                    output_lang=SYNTAX_RAW;
+                } else if (syntax_is(optarg, lang_len, "decimal")) {
+                    output_lang=SYNTAX_DECIMAL;
+                }
+                if (ntargets == MAX_SYNTAX_TARGETS) {
+                    fprintf(stderr, "%s: at most %d --syntax options can be "
+                            "given.\n", argv[0], MAX_SYNTAX_TARGETS);
+                    exit(EXIT_FAILURE);
+                }
+                targets[ntargets].lang = output_lang;
+                targets[ntargets].filename = syntax_file;
+                ntargets++;
+                break;
+            case OPT_STRINGS:   /* printable strings extraction */
+                doScanStrings = true;
+                if (optarg == NULL || strcmp(optarg, "ascii") == 0) {
+                    strings_encodings = STRSCAN_ASCII;
+                } else if (strcmp(optarg, "utf16le") == 0) {
+                    strings_encodings = STRSCAN_UTF16LE;
+                } else if (strcmp(optarg, "all") == 0) {
+                    strings_encodings = STRSCAN_ASCII | STRSCAN_UTF16LE;
+                } else {
+                    fprintf(stderr, "%s: unknown strings encoding `%s'.\n",
+                            argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_ENTROPY:   /* entropy map */
+                doEntropyMap = true;
+                break;
+            case OPT_SEARCH:    /* byte pattern to search */
+                if (searcher_add(&searcher, optarg) < 0) {
+                    fprintf(stderr, "%s: invalid search pattern `%s'.\n",
+                            argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_PATTERNS:  /* byte patterns file */
+                read_search_patterns(&searcher, optarg);
+                break;
+            case OPT_INPUT_FORMAT:  /* -x input format */
+                input_format = dump_format_from_name(optarg);
+                if (input_format < DUMP_AUTO) {
+                    fprintf(stderr, "%s: unknown input format `%s'.\n",
+                            argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_RAW:       /* raw bytes output */
+                doRawOutput = true;
+                break;
+            case OPT_HUGE_PAGES:    /* huge pages backed buffers */
+                set_huge_pages(1);
+                break;
+            case OPT_EXCLUDE:   /* bytes left out of -b */
+                if (parse_byte_set(optarg, badchar.excluded) == false) {
+                    fprintf(stderr, "%s: invalid byte list `%s'.\n",
+                            argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+                doBadcharOptions = true;
+                break;
+            case OPT_RANGE:     /* -b sequence range */
+                range_end = parse_byte_range(optarg, &badchar.first,
+                                             &badchar.last);
+                if (range_end == NULL || *range_end != '\0') {
+                    fprintf(stderr, "%s: invalid byte range `%s'.\n",
+                            argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+                doBadcharOptions = true;
+                break;
+            case OPT_REVERSE:   /* -b sequence in reverse order */
+                badchar.reverse = true;
+                doBadcharOptions = true;
+                break;
+            case OPT_ROUNDS:    /* -b sequence repetitions */
+                /* strtoul() would take negative counts modulo ULONG_MAX */
+                errno = 0;
+                badchar.rounds = strtoul(optarg, &rounds_end, 10);
+                if (rounds_end == optarg || *rounds_end != '\0' ||
+                    strchr(optarg, '-') != NULL || errno != 0 ||
+                    badchar.rounds < 1) {
+                    fprintf(stderr, "%s: invalid rounds count `%s'.\n",
+                            argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+                doBadcharOptions = true;
+                break;
+            case OPT_PID:       /* process whose memory is read */
+                proc_pid = strtol(optarg, &pid_end, 10);
+                if (pid_end == optarg || *pid_end != '\0' || proc_pid < 1) {
+                    fprintf(stderr, "%s: invalid process id `%s'.\n",
+                            argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_ADDRESS:   /* hexadecimal address in the process */
+                proc_address = strtoull(optarg, &pid_end, 16);
+                if (pid_end == optarg || *pid_end != '\0') {
+                    fprintf(stderr, "%s: invalid address `%s'.\n",
+                            argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+                doProcAddress = true;
+                break;
+            case OPT_LENGTH:    /* bytes read from the process */
+                proc_length = parse_size(optarg);
+                if (proc_length == 0) {
+                    fprintf(stderr, "%s: --length is at least 1 byte.\n",
+                            argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                doProcLength = true;
+                break;
+            case OPT_ZERO_RUNS: /* compact runs of zero bytes */
+            case OPT_RUNS:      /* compact runs of any byte */
+                doByteRuns = opt == OPT_RUNS;
+                run_min = optarg != NULL ? parse_size(optarg) :
+                          doByteRuns ? BYTE_RUN_MIN : ZERO_RUN_MIN;
+                if (run_min < 2) {
+                    fprintf(stderr, "%s: runs are at least 2 bytes "
+                            "long.\n", argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_CHECKSUM:  /* checksums computed along the encoding */
+                checksum_kinds = parse_checksum_kinds(optarg);
+                if (checksum_kinds <= 0) {
+                    fprintf(stderr, "%s: invalid checksum list `%s'.\n",
+                            argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_JSON:      /* NDJSON records for pipelines */
+                doJsonOutput = true;
+                break;
+            case OPT_CONCAT:    /* input files as one binary string */
+                batch_layout = BATCH_CONCAT;
+                break;
+            case OPT_ARRAYS:    /* input files as named arrays */
+                batch_layout = BATCH_ARRAYS;
+                break;
+            case OPT_INCBIN:    /* .incbin assembler source and header */
+                incbin_base = optarg;
+                break;
+            case OPT_PIPELINE:  /* reader, encoder and writer threads */
+                doPipeline = true;
+                break;
+            case OPT_LINE:      /* line by line conversion */
+                doLineInput = true;
+                break;
+            case OPT_OUTPUT:    /* output file */
+                output_filename = optarg;
+                break;
+            case OPT_WATCH:     /* keep the output file up to date */
+                doWatchInput = true;
+                break;
+            case OPT_CACHE:     /* output cache directory */
+                cache_dir = optarg;
+                break;
+            case OPT_CACHE_SIZE:    /* output cache size limit */
+                cache_size = parse_size(optarg);
+                break;
+            case OPT_MAX_MEMORY:    /* buffers memory limit */
+                max_memory = parse_size(optarg);
+                if (max_memory < MEMORY_LIMIT_MIN) {
+                    fprintf(stderr, "%s: --max-memory is at least %dM.\n",
+                            argv[0], MEMORY_LIMIT_MIN >> 20);
+                    exit(EXIT_FAILURE);
                 }
-                if (strcmp(arg_lang, "c") == 0) {
-                    output_lang=1;
-                } else if (strcmp(arg_lang, "python") == 0) {
-                    output_lang=2;
+                set_memory_limit(max_memory);
+                break;
+            case OPT_NO_DECOMPRESS: /* compressed input as is */
+                set_decompression(0);
+                break;
+            case OPT_SECTION:   /* ELF section to dump */
+                elf_section = optarg;
+                elf_symbol = NULL;
+                break;
+            case OPT_SYMBOL:    /* ELF symbol to dump */
+                elf_symbol = optarg;
+                elf_section = NULL;
+                break;
+            case OPT_WINDOW:    /* entropy map window size */
+                entropy_window = parse_size(optarg);
+                break;
+            case OPT_STEP:      /* entropy map window step */
+                entropy_step = parse_size(optarg);
+                break;
+            case OPT_THREADS:   /* worker threads count */
+                nthreads = atoi(optarg);
+                if (nthreads < 1 || nthreads > MAX_THREADS) {
+                    fprintf(stderr, "%s: threads count must be between 1 "
+                            "and %d.\n", argv[0], MAX_THREADS);
+                    exit(EXIT_FAILURE);
                 }
                 break;
+            case 'n':   /* minimum strings length option */
+                if (optarg != NULL && atoi(optarg) > 0)
+                    strings_min_length = atoi(optarg);
+                break;
             case 'w':   /* binary string width option */
                 doLimitBinaryStringWidth = true;
                 /* make sure 'optarg' isn't null before using it */
@@ -479,20 +2217,325 @@ int main(int argc, char *argv[])
         }
     }
 
+    /* the -b sequence is generated, it reads no input */
+    if (doOutputBadCharString == true && doOutputHexEscapedString == false &&
+        doHexDumpFile == false && (doReadFromFile == true || optind < argc)) {
+        fprintf(stderr, "%s: -b reads no input file, unexpected argument "
+                "`%s'.\n", argv[0], optind < argc ? argv[optind]
+                                                   : fread_filename);
+        exit(EXIT_FAILURE);
+    }
+
     /* simple conditional check to ensure at least a valid option is given at
      * the command-line, otherwise call print_usage() function.
      */
-    if ((optind < argc) || argc == 1) {
+    if (((optind < argc) && !(doHexDumpFile || doReadFromFile)) ||
+        argc == 1) {
         print_usage(stdout, argv[0]);
         exit(EXIT_SUCCESS);
     }
 
+    /* the remaining arguments are additional -D or -f input files, all of
+     * them are converted in one batch.
+     */
+    while (optind < argc)
+        input_files[ninput_files++] = argv[optind++];
+    if (ninput_files > 1 && (doScanStrings == true ||
+        searcher.npatterns > 0 || doEntropyMap == true ||
+        elf_section != NULL || elf_symbol != NULL)) {
+        fprintf(stderr, "%s: multiple input files are only supported by "
+                "-x and -D.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    /* the size of an output file is computed up front, which requires a
+     * single binary input.
+     */
+    if (output_filename != NULL && (ninput_files > 1 ||
+        doScanStrings == true || searcher.npatterns > 0 ||
+        doEntropyMap == true || doRawOutput == true ||
+        (doHexDumpFile == false && (doOutputBadCharString == false ||
+                                    doOutputHexEscapedString == true)))) {
+        fprintf(stderr, "%s: --output requires a single -D file or -b.\n",
+                argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (doWatchInput == true && (output_filename == NULL ||
+        doHexDumpFile == false || elf_section != NULL || elf_symbol != NULL)) {
+        fprintf(stderr, "%s: --watch requires a -D file and --output.\n",
+                argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (doLineInput == true && (doOutputHexEscapedString == false ||
+        doHexDumpFile == true || doReadFromFile == true ||
+        doRawOutput == true || cache_dir != NULL)) {
+        fprintf(stderr, "%s: --line requires -x reading the standard "
+                "input.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ntargets > 1)
+        doSyntaxTargets = true;
+    if (doSyntaxTargets == true) {
+        int nstdout = 0, i;
+
+        for (i = 0; i < ntargets; i++)
+            nstdout += targets[i].filename == NULL;
+        if (doOutputHexEscapedString == false || nstdout > 1 ||
+            ninput_files > 1 || output_filename != NULL ||
+            cache_dir != NULL || doRawOutput == true ||
+            doLineInput == true || doPipeline == true ||
+            doScanStrings == true || searcher.npatterns > 0 ||
+            doEntropyMap == true || elf_section != NULL ||
+            elf_symbol != NULL) {
+            fprintf(stderr, "%s: several --syntax outputs require -x, and "
+                    "a LANG:FILE output for all of them but one.\n",
+                    argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* decimal lists have no fixed size per byte, mapped output files of
+     * dumps cannot be allocated up front. -b output is streamed.
+     */
+    if (output_lang == SYNTAX_DECIMAL && output_filename != NULL &&
+        doOutputBadCharString == false) {
+        fprintf(stderr, "%s: --output of dumps requires a c, python or raw "
+                "--syntax.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if ((doProcAddress == true || doProcLength == true) && proc_pid == 0) {
+        fprintf(stderr, "%s: --address and --length require --pid.\n",
+                argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (proc_pid != 0 && (doHexDumpFile == true || doReadFromFile == true ||
+        doOutputBadCharString == true || output_filename != NULL ||
+        cache_dir != NULL || incbin_base != NULL || doRawOutput == true ||
+        doLineInput == true || doPipeline == true ||
+        doSyntaxTargets == true || doScanStrings == true ||
+        searcher.npatterns > 0 || doEntropyMap == true)) {
+        fprintf(stderr, "%s: --pid only lists the process regions, or "
+                "dumps one with -x or alone.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (run_min != 0 && (doHexDumpFile == false || ninput_files > 1 ||
+        output_filename != NULL || cache_dir != NULL ||
+        incbin_base != NULL || doRawOutput == true || doPipeline == true ||
+        doSyntaxTargets == true || doScanStrings == true ||
+        searcher.npatterns > 0 || doEntropyMap == true ||
+        checksum_kinds != 0 || batch_layout != BATCH_STRINGS ||
+        elf_section != NULL || elf_symbol != NULL)) {
+        fprintf(stderr, "%s: --zero-runs and --runs require a single -D "
+                "file.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    /* the runs would be lost in the raw syntax, which has no statements */
+    if (run_min != 0 && doOutputHexEscapedString == true &&
+        output_lang == SYNTAX_RAW) {
+        fprintf(stderr, "%s: --zero-runs and --runs require -s c, python "
+                "or decimal with -x.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (doJsonOutput == true && ((doHexDumpFile == false &&
+                                  doReadFromFile == false) ||
+        (doHexDumpFile == false && doOutputHexEscapedString == false) ||
+        output_filename != NULL || cache_dir != NULL ||
+        incbin_base != NULL || doRawOutput == true || doLineInput == true ||
+        doPipeline == true || doWatchInput == true || run_min != 0 ||
+        doSyntaxTargets == true || doScanStrings == true ||
+        searcher.npatterns > 0 || doEntropyMap == true ||
+        elf_section != NULL || elf_symbol != NULL)) {
+        fprintf(stderr, "%s: --json requires -D files or -x -f files, and "
+                "no other output.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (batch_layout != BATCH_STRINGS && ((doHexDumpFile == false &&
+                                           doReadFromFile == false) ||
+        (doHexDumpFile == false && doOutputHexEscapedString == false) ||
+        output_filename != NULL || cache_dir != NULL ||
+        incbin_base != NULL || doRawOutput == true || doLineInput == true ||
+        doWatchInput == true || doJsonOutput == true || run_min != 0 ||
+        doSyntaxTargets == true || doScanStrings == true ||
+        searcher.npatterns > 0 || doEntropyMap == true ||
+        elf_section != NULL || elf_symbol != NULL)) {
+        fprintf(stderr, "%s: --concat and --arrays require -D files or -x -f "
+                "files, and no other output.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (batch_layout == BATCH_CONCAT && checksum_kinds != 0) {
+        fprintf(stderr, "%s: --checksum can't be combined with --concat.\n",
+                argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (batch_layout == BATCH_ARRAYS && (doOutputHexEscapedString == false ||
+                                         output_lang == SYNTAX_RAW)) {
+        fprintf(stderr, "%s: --arrays requires -x and the c, python or "
+                "decimal syntax.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (checksum_kinds != 0 && ((doHexDumpFile == false &&
+                                 doJsonOutput == false) ||
+        output_filename != NULL || cache_dir != NULL ||
+        incbin_base != NULL || doRawOutput == true || run_min != 0 ||
+        doSyntaxTargets == true || doScanStrings == true ||
+        searcher.npatterns > 0 || doEntropyMap == true ||
+        elf_section != NULL || elf_symbol != NULL)) {
+        fprintf(stderr, "%s: --checksum requires -D files or --json, and no "
+                "--output or --cache.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (incbin_base != NULL && ((doHexDumpFile == false &&
+                                 doOutputHexEscapedString == false) ||
+        ninput_files > 1 || output_filename != NULL || cache_dir != NULL ||
+        doRawOutput == true || doLineInput == true || doPipeline == true ||
+        doSyntaxTargets == true || doOutputBadCharString == true ||
+        doScanStrings == true || searcher.npatterns > 0 ||
+        doEntropyMap == true)) {
+        fprintf(stderr, "%s: --incbin requires a single -D file or -x "
+                "input.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    /* the assembler source and header have a syntax of their own */
+    if (incbin_base != NULL && ntargets > 0) {
+        fprintf(stderr, "%s: --incbin can't be combined with --syntax.\n",
+                argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (incbin_base != NULL && strlen(incbin_base) + 5 >
+                               MAX_FILENAME_LENGTH) {
+        fprintf(stderr, "%s: --incbin name is too long.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (doBadcharOptions == true && doOutputBadCharString == false) {
+        fprintf(stderr, "%s: --exclude, --range, --reverse and --rounds "
+                "require -b.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (doOutputBadCharString == true) {
+        int c = badchar.first;
+
+        while (c <= badchar.last && badchar.excluded[c] != 0)
+            c++;
+        if (c > badchar.last) {
+            fprintf(stderr, "%s: every byte of the -b range is excluded.\n",
+                    argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (doPipeline == true && ((doHexDumpFile == false &&
+                               doReadFromFile == false) ||
+        output_filename != NULL || cache_dir != NULL ||
+        elf_section != NULL || elf_symbol != NULL ||
+        (doOutputHexEscapedString == false && doHexDumpFile == false) ||
+        doScanStrings == true || searcher.npatterns > 0 ||
+        doEntropyMap == true)) {
+        fprintf(stderr, "%s: --pipeline requires -x or -D with input files "
+                "and no --output or --cache.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    /* cache keys are hashed from whole inputs, which can't be streamed */
+    if (max_memory != 0 && cache_dir != NULL) {
+        fprintf(stderr, "%s: --max-memory and --cache can't be used "
+                "together.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    /* if --pid option is given */
+    if (proc_pid != 0) {
+        if (doProcAddress == true)
+            dump_process_memory(proc_pid, proc_address, proc_length,
+                                doOutputHexEscapedString, ptr_out_lang,
+                                string_width, nthreads);
+        else
+            list_process_regions(proc_pid);
+        /* exit as we're the last action */
+        exit(EXIT_SUCCESS);
+    }
+
+    /* if --incbin option is given */
+    if (incbin_base != NULL) {
+        output_incbin((doReadFromFile || doHexDumpFile) ? fread_filename
+                                                        : NULL,
+                      doHexDumpFile, input_format, elf_section, elf_symbol,
+                      incbin_base, nthreads);
+        /* exit as we're the last action */
+        exit(EXIT_SUCCESS);
+    }
+
+    /* if --strings option is given */
+    if (doScanStrings == true) {
+        /* toggle verbosity if flag set */
+        if (verbose_flag == true) {
+            printf("[*] Extract printable strings of at least %zu "
+                   "character(s).\n", strings_min_length);
+        }
+        /* read from -f|--file or -D|--dump-file if given, stdin otherwise.
+         * hits are output as escaped binary strings if -x is also given.
+         */
+        output_printable_strings((doReadFromFile || doHexDumpFile) ?
+                                 fread_filename : NULL, strings_encodings,
+                                 strings_min_length, doOutputHexEscapedString,
+                                 ptr_out_lang, string_width);
+        /* exit as we're the last action */
+        exit(EXIT_SUCCESS);
+    }
+
+    /* if --search or --patterns options are given */
+    if (searcher.npatterns > 0) {
+        /* toggle verbosity if flag set */
+        if (verbose_flag == true) {
+            printf("[*] Search %d byte pattern(s) with %d thread(s).\n",
+                   searcher.npatterns, nthreads);
+        }
+        /* matches are output as escaped binary strings if -x is given */
+        output_search_hits((doReadFromFile || doHexDumpFile) ?
+                           fread_filename : NULL, &searcher,
+                           doOutputHexEscapedString, ptr_out_lang,
+                           string_width, nthreads);
+        searcher_free(&searcher);
+        /* exit as we're the last action */
+        exit(EXIT_SUCCESS);
+    }
+
+    /* if --entropy option is given */
+    if (doEntropyMap == true) {
+        /* windows are contiguous unless a step is given */
+        if (entropy_window == 0) {
+            fprintf(stderr, "%s: window size cannot be zero.\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        if (entropy_step == 0)
+            entropy_step = entropy_window;
+        /* toggle verbosity if flag set */
+        if (verbose_flag == true) {
+            printf("[*] Entropy map of %zu byte(s) windows every %zu "
+                   "byte(s), %d thread(s).\n", entropy_window, entropy_step,
+                   nthreads);
+        }
+        output_entropy_map((doReadFromFile || doHexDumpFile) ?
+                           fread_filename : NULL, entropy_window,
+                           entropy_step, nthreads);
+        /* exit as we're the last action */
+        exit(EXIT_SUCCESS);
+    }
+
     /* if -x|--hex-escape option is given */
     if (doOutputHexEscapedString == true) {
         /* initialize integer 'array_size' */
         int array_size = 1;
         /* toggle verbosity if flag set */
-        if (verbose_flag == true) {
+        if (verbose_flag == true && doJsonOutput == false) {
             printf("[*] Convert hexadecimal input to an escaped binary string"
                    ".\n");
             if (doLimitBinaryStringWidth == true) {
@@ -500,23 +2543,89 @@ int main(int argc, char *argv[])
                        string_width);
             }
         }
-        /* if -D|--dump-file option is additionally given */
-        if (doHexDumpFile == true) {
-            /* call to read_from_file() */
-            ptr_char_array = read_from_file(fread_filename, &array_size, 2);
+        /* if an ELF section or symbol of the -D file is to be dumped */
+        if (doHexDumpFile == true &&
+            (elf_section != NULL || elf_symbol != NULL)) {
+            dump_elf_range(fread_filename, elf_section, elf_symbol, true,
+                           output_filename, ptr_out_lang, string_width,
+                           nthreads);
+            exit(EXIT_SUCCESS);
+        }
+        /* -D output written to a file */
+        if (doHexDumpFile == true && doWatchInput == true) {
+            watch_dump_file(fread_filename, output_filename, true,
+                            ptr_out_lang, string_width, nthreads);
         }
-        /* if -f|--file option is given read from file instead of stdin */
-        else if (doReadFromFile == true) {
-            /* call to read_from_file() */
-            ptr_char_array = read_from_file(fread_filename, &array_size, 1);
+        if (doHexDumpFile == true && output_filename != NULL) {
+            dump_to_file(fread_filename, output_filename, true, ptr_out_lang,
+                         string_width, nthreads);
+            exit(EXIT_SUCCESS);
         }
-        else {
-            /* call to read_and_store_char_input() */
-            ptr_char_array = read_and_store_char_input(&array_size);
+        /* several input files are read in one batch, as are pipelined ones,
+         * files whose checksums are computed along, NDJSON records and
+         * arrays.
+         */
+        if (ninput_files > 1 || doPipeline == true || checksum_kinds != 0 ||
+            doJsonOutput == true || batch_layout != BATCH_STRINGS) {
+            output_hex_files(input_files, ninput_files, true, doHexDumpFile,
+                             doRawOutput, ptr_out_lang, string_width,
+                             input_format, nthreads, doPipeline,
+                             checksum_kinds, doJsonOutput, batch_layout);
+            exit(EXIT_SUCCESS);
+        }
+        /* standard input converted line by line, as it arrives */
+        if (doLineInput == true) {
+            output_hex_escaped_lines(ptr_out_lang, string_width,
+                                     input_format);
+            exit(EXIT_SUCCESS);
+        }
+        /* runs of repeated bytes of the -D file are output compactly */
+        if (run_min != 0) {
+            output_byte_runs(fread_filename, true, ptr_out_lang,
+                             string_width, run_min, doByteRuns, nthreads);
+            exit(EXIT_SUCCESS);
+        }
+        /* several syntaxes are output from a single pass over the input */
+        if (doSyntaxTargets == true) {
+            output_hex_escaped_targets((doReadFromFile || doHexDumpFile) ?
+                                       fread_filename : NULL, doHexDumpFile,
+                                       targets, ntargets, string_width,
+                                       input_format, nthreads);
+            exit(EXIT_SUCCESS);
+        }
+        /* under a memory limit, inputs are streamed in blocks rather than
+         * mapped, or read whole if they can't be.
+         */
+        if (max_memory != 0 &&
+            (doHexDumpFile == true || doReadFromFile == true ||
+             interactive_flag == false)) {
+            if (ninput_files == 0)
+                input_files[ninput_files++] = (char *)"/dev/stdin";
+            output_hex_files(input_files, ninput_files, true, doHexDumpFile,
+                             doRawOutput, ptr_out_lang, string_width,
+                             input_format, nthreads, doPipeline,
+                             checksum_kinds, doJsonOutput, batch_layout);
+            exit(EXIT_SUCCESS);
+        }
+        /* if -D|--dump-file or -f|--file options are additionally given,
+         * or if stdin isn't interactive, convert the mapped input with the
+         * parallel encoders.
+         */
+        if (doHexDumpFile == true || doReadFromFile == true ||
+            interactive_flag == false) {
+            cache_open(&cache, cache_dir, cache_size);
+            output_hex_escaped_input((doReadFromFile || doHexDumpFile) ?
+                                     fread_filename : NULL, doHexDumpFile,
+                                     doRawOutput, ptr_out_lang, string_width,
+                                     input_format, nthreads, &cache);
+            cache_close(&cache);
+            exit(EXIT_SUCCESS);
         }
+        /* interactive mode: call to read_and_store_char_input() */
+        ptr_char_array = read_and_store_char_input(&array_size);
         /* call to output_hex_escaped_string() */
         output_hex_escaped_string(ptr_char_array, &array_size, ptr_out_lang,
-                                  string_width);
+                                  string_width, input_format);
         /* call to free() for 'ptr_char_array' */
         free(ptr_char_array);
         /* exit as we're the last action */
@@ -525,16 +2634,40 @@ int main(int argc, char *argv[])
 
     /* if -D|--dump-file option is given */
     if (doHexDumpFile == true) {
-        /* call to read_from_file() */
-        read_from_file(fread_filename, NULL, 0);
+        /* dump only an ELF section or symbol if asked to */
+        if (elf_section != NULL || elf_symbol != NULL) {
+            dump_elf_range(fread_filename, elf_section, elf_symbol, false,
+                           output_filename, ptr_out_lang, string_width,
+                           nthreads);
+            exit(EXIT_SUCCESS);
+        }
+        /* output the file content to a file */
+        if (doWatchInput == true) {
+            watch_dump_file(fread_filename, output_filename, false,
+                            ptr_out_lang, string_width, nthreads);
+        }
+        if (output_filename != NULL) {
+            dump_to_file(fread_filename, output_filename, false,
+                         ptr_out_lang, string_width, nthreads);
+            exit(EXIT_SUCCESS);
+        }
+        /* runs of repeated bytes of the file are marked, not dumped */
+        if (run_min != 0) {
+            output_byte_runs(fread_filename, false, ptr_out_lang,
+                             string_width, run_min, doByteRuns, nthreads);
+            exit(EXIT_SUCCESS);
+        }
+        /* output the files content in plain hexadecimal */
+        output_hex_files(input_files, ninput_files, false, true, false,
+                         ptr_out_lang, string_width, DUMP_PLAIN, nthreads,
+                         doPipeline, checksum_kinds, doJsonOutput,
+                         batch_layout);
         /* exit as we're the last action */
         exit(EXIT_SUCCESS);
     }
 
     /* if -b|--gen-badchar option is given */
     if (doOutputBadCharString == true) {
-        /* initialize integer 'array_size' to BADCHAR_HEX_SEQLEN bytes */
-        int array_size = BADCHAR_HEX_SEQLEN;
         /* toggle verbosity if flag set */
         if (verbose_flag == true) {
             printf("[*] Generating bad character binary string.\n");
@@ -543,13 +2676,9 @@ int main(int argc, char *argv[])
                        string_width);
             }
         }
-        /* call to generate_badchar_sequence() */
-        ptr_char_array = generate_badchar_sequence();
-        /* call to output_hex_escaped_string() */
-        output_hex_escaped_string(ptr_char_array, &array_size, ptr_out_lang,
-                                  string_width);
-        /* call to free() for 'ptr_char_array' */
-        free(ptr_char_array);
+        /* the sequence is generated as bytes and escaped right away */
+        output_badchar_sequence(&badchar, output_filename, ptr_out_lang,
+                                string_width, nthreads);
         /* exit as we're the last action */
         exit(EXIT_SUCCESS);
     }
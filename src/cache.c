@@ -0,0 +1,314 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * cache.c - content-addressed output cache
+ *
+ * Outputs are stored in a directory, one file per output named after a key
+ * hashed from the input content and every option the output depends on.
+ * A hit is sent to the output with sendfile(), without formatting anything.
+ * A miss records the output while it is produced, in a temporary file
+ * renamed into place once complete, so concurrent runs never see partial
+ * entries.
+ *
+ * Entries start with a header holding the diagnostics of the conversion,
+ * such as the number of invalid characters of the input, so hits report
+ * them as the conversion did.
+ *
+ * Hits refresh the entries' modification time, and the least recently used
+ * entries are removed whenever the cache grows over its size limit. The
+ * number of hits and misses is kept in a 'stats' file of the directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include "include/alloc.h"
+#include "include/emit.h"
+#include "include/cache.h"
+
+#define CACHE_STATS_FILE    "stats"     /* hits and misses counters */
+#define CACHE_TMP_PREFIX    ".tmp."     /* entries being written */
+
+/* diagnostics of the conversion, ahead of its output in the entry */
+struct cache_header {
+    unsigned long invalid;
+    int nibble;
+};
+
+/* an entry considered for eviction */
+struct cache_entry {
+    char name[256];
+    time_t mtime;
+    unsigned long long size;
+};
+
+static void cache_update_stats(struct cache *c, int hit)
+{
+    char path[4096], text[64];
+    ssize_t n;
+    int fd;
+
+    /* counters are shared by concurrent runs, under an exclusive lock */
+    snprintf(path, sizeof(path), "%s/%s", c->dir, CACHE_STATS_FILE);
+    fd = open(path, O_RDWR | O_CREAT, 0666);
+    if (fd < 0)
+        return;
+    flock(fd, LOCK_EX);
+    n = pread(fd, text, sizeof(text) - 1, 0);
+    text[n > 0 ? n : 0] = '\0';
+    if (sscanf(text, "%lu %lu", &c->hits, &c->misses) != 2)
+        c->hits = c->misses = 0;
+    if (hit)
+        c->hits++;
+    else
+        c->misses++;
+    n = snprintf(text, sizeof(text), "%lu %lu\n", c->hits, c->misses);
+    if (pwrite(fd, text, n, 0) != n || ftruncate(fd, n) != 0)
+        c->hits = c->misses = 0;
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    const struct cache_entry *ea = a, *eb = b;
+
+    return ea->mtime < eb->mtime ? -1 : ea->mtime > eb->mtime;
+}
+
+static void cache_evict(struct cache *c)
+{
+    struct cache_entry *entries = NULL;
+    size_t n = 0, size = 0, i;
+    unsigned long long total = 0;
+    struct dirent *de;
+    struct stat st;
+    char path[4096];
+    DIR *d = opendir(c->dir);
+
+    if (d == NULL)
+        return;
+
+    /* list the complete entries with their size and last use */
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.' ||
+            strcmp(de->d_name, CACHE_STATS_FILE) == 0)
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", c->dir, de->d_name);
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+        if (n == size) {
+            size = size ? 2 * size : 64;
+            entries = (struct cache_entry *)change_dynamic_memory(
+                          (char *)entries, sizeof(*entries) * size);
+        }
+        snprintf(entries[n].name, sizeof(entries[n].name), "%s",
+                 de->d_name);
+        entries[n].mtime = st.st_mtime;
+        entries[n].size = st.st_size;
+        total += st.st_size;
+        n++;
+    }
+    closedir(d);
+
+    /* remove the least recently used ones until the cache fits */
+    if (total > c->max_size) {
+        qsort(entries, n, sizeof(*entries), compare_entries);
+        for (i = 0; i < n && total > c->max_size; i++) {
+            snprintf(path, sizeof(path), "%s/%s", c->dir, entries[i].name);
+            if (unlink(path) == 0)
+                total -= entries[i].size;
+        }
+    }
+    free(entries);
+}
+
+void cache_open(struct cache *c, const char *dir,
+                unsigned long long max_size)
+{
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    if (dir == NULL)
+        return;
+
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "[-] Warning: cache directory \"%s\" cannot be "
+                        "created, caching disabled.\n", dir);
+        return;
+    }
+    c->dir = allocate_dynamic_memory(strlen(dir) + 1);
+    strcpy(c->dir, dir);
+    c->max_size = max_size;
+}
+
+int cache_lookup(struct cache *c, unsigned long long key)
+{
+    struct cache_header header;
+
+    if (c->dir == NULL)
+        return 0;
+
+    snprintf(c->path, sizeof(c->path), "%s/%016llx", c->dir, key);
+    c->fd = open(c->path, O_RDONLY);
+    /* an entry without its header is treated as missing */
+    if (c->fd >= 0 &&
+        pread(c->fd, &header, sizeof(header), 0) != sizeof(header)) {
+        close(c->fd);
+        c->fd = -1;
+    }
+    if (c->fd >= 0) {
+        c->invalid = header.invalid;
+        c->nibble = header.nibble;
+    }
+    cache_update_stats(c, c->fd >= 0);
+    return c->fd >= 0;
+}
+
+void cache_send(struct cache *c, FILE *stream)
+{
+    struct stat st;
+    off_t offset = sizeof(struct cache_header);
+    ssize_t n;
+
+    if (fstat(c->fd, &st) != 0)
+        st.st_size = 0;
+
+    /* send the entry as it is, it's now the most recently used */
+    fflush(stream);
+    while (offset < st.st_size) {
+        n = sendfile(fileno(stream), c->fd, &offset, st.st_size - offset);
+        if (n <= 0)
+            break;
+    }
+    /* not every output supports sendfile(), copy the rest */
+    while (offset < st.st_size) {
+        char buf[65536];
+
+        n = pread(c->fd, buf, sizeof(buf), offset);
+        if (n <= 0)
+            break;
+        fwrite(buf, sizeof(char), n, stream);
+        offset += n;
+    }
+    futimens(c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+}
+
+static void cache_tee(void *ctx, const char *data, size_t len)
+{
+    struct cache *c = ctx;
+    const char *p = data;
+    size_t left = len;
+    ssize_t n;
+
+    /* the emitter's pending output goes first */
+    if (data != c->em->buf && c->em->len > 0)
+        emit_flush(c->em);
+
+    /* record the output on its way out, giving up on write errors */
+    while (c->fd >= 0 && left > 0) {
+        n = write(c->fd, p, left);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            close(c->fd);
+            unlink(c->tmp);
+            c->fd = -1;
+            break;
+        }
+        p += n;
+        left -= n;
+    }
+    c->flush(c->ctx, data, len);
+}
+
+void cache_record(struct cache *c, struct emitter *em)
+{
+    /* only after a missed lookup, which named the entry */
+    if (c->dir == NULL)
+        return;
+
+    snprintf(c->tmp, sizeof(c->tmp), "%s/" CACHE_TMP_PREFIX "XXXXXX",
+             c->dir);
+    c->fd = mkstemp(c->tmp);
+    if (c->fd < 0)
+        return;
+    /* room for the header, written once the conversion is complete */
+    if (ftruncate(c->fd, sizeof(struct cache_header)) != 0 ||
+        lseek(c->fd, sizeof(struct cache_header), SEEK_SET) < 0) {
+        close(c->fd);
+        unlink(c->tmp);
+        c->fd = -1;
+        return;
+    }
+
+    /* the emitter's output goes through the cache first */
+    c->em = em;
+    c->flush = em->flush;
+    c->ctx = em->ctx;
+    em->flush = cache_tee;
+    em->ctx = c;
+}
+
+void cache_commit(struct cache *c)
+{
+    struct cache_header header;
+    int written;
+
+    if (c->em == NULL)
+        return;
+
+    /* the emitter is handed back its output */
+    emit_flush(c->em);
+    memset(&header, 0, sizeof(header));
+    header.invalid = c->em->invalid;
+    header.nibble = c->em->nibble;
+    c->em->flush = c->flush;
+    c->em->ctx = c->ctx;
+    c->em = NULL;
+
+    if (c->fd < 0)
+        return;
+    written = pwrite(c->fd, &header, sizeof(header), 0) == sizeof(header);
+    if (close(c->fd) == 0 && written && rename(c->tmp, c->path) == 0)
+        cache_evict(c);
+    else
+        unlink(c->tmp);
+    c->fd = -1;
+}
+
+void cache_close(struct cache *c)
+{
+    /* an entry still being recorded is incomplete */
+    if (c->fd >= 0) {
+        close(c->fd);
+        unlink(c->tmp);
+        c->fd = -1;
+    }
+    free(c->dir);
+    c->dir = NULL;
+}
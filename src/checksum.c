@@ -0,0 +1,364 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * checksum.c - CRC32, CRC32C and SHA-256 checksums
+ *
+ * Checksums are updated with the blocks of an input while they are being
+ * encoded, so they cost no additional read of it. CRC32 is computed eight
+ * bytes at a time with sliced tables. On x86-64 processors supporting them,
+ * CRC32C uses the SSE4.2 crc32 instruction and SHA-256 the SHA extensions,
+ * both selected at run time; portable versions are used otherwise.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/checksum.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CHECKSUM_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#define CRC32_POLY          0xedb88320  /* reflected polynomials */
+#define CRC32C_POLY         0x82f63b78
+
+static const struct {
+    int kind;
+    const char *name;
+} checksum_names[] = {
+    { CHECKSUM_CRC32, "crc32" },
+    { CHECKSUM_CRC32C, "crc32c" },
+    { CHECKSUM_SHA256, "sha256" },
+};
+
+static const unsigned int sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const unsigned int sha256_init[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+/* sliced tables, built on first use */
+static unsigned int crc32_table[8][256];
+static unsigned int crc32c_table[8][256];
+static int tables_ready;
+
+/* block functions selected on first use */
+static unsigned int (*crc32c_update)(unsigned int crc,
+                                     const unsigned char *p, size_t len);
+static void (*sha256_blocks)(unsigned int state[8], const unsigned char *p,
+                             size_t blocks);
+
+int parse_checksum_kinds(const char *list)
+{
+    int kinds = 0;
+    size_t i, n;
+
+    /* comma separated checksum names */
+    while (*list != '\0') {
+        n = strcspn(list, ",");
+        for (i = 0; i < sizeof(checksum_names) / sizeof(*checksum_names);
+             i++) {
+            if (strlen(checksum_names[i].name) == n &&
+                strncmp(list, checksum_names[i].name, n) == 0)
+                break;
+        }
+        if (i == sizeof(checksum_names) / sizeof(*checksum_names))
+            return -1;
+        kinds |= checksum_names[i].kind;
+        list += n;
+        if (*list == ',')
+            list++;
+    }
+    return kinds;
+}
+
+const char * checksum_name(int kind)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(checksum_names) / sizeof(*checksum_names); i++) {
+        if (checksum_names[i].kind == kind)
+            return checksum_names[i].name;
+    }
+    return "unknown";
+}
+
+static void build_table(unsigned int table[8][256], unsigned int poly)
+{
+    unsigned int c;
+    int i, k;
+
+    for (i = 0; i < 256; i++) {
+        c = i;
+        for (k = 0; k < 8; k++)
+            c = c & 1 ? (c >> 1) ^ poly : c >> 1;
+        table[0][i] = c;
+    }
+    /* table[k] advances a byte followed by k zero bytes */
+    for (i = 0; i < 256; i++) {
+        for (k = 1; k < 8; k++)
+            table[k][i] = (table[k-1][i] >> 8) ^
+                          table[0][table[k-1][i] & 0xff];
+    }
+}
+
+static unsigned int crc_sliced(unsigned int table[8][256], unsigned int crc,
+                               const unsigned char *p, size_t len)
+{
+    unsigned int lo, hi;
+
+    crc = ~crc;
+    /* eight bytes at a time, in little-endian order */
+    for (; len >= 8; p += 8, len -= 8) {
+        lo = crc ^ (p[0] | p[1] << 8 | p[2] << 16 | (unsigned int)p[3] << 24);
+        hi = p[4] | p[5] << 8 | p[6] << 16 | (unsigned int)p[7] << 24;
+        crc = table[7][lo & 0xff] ^ table[6][(lo >> 8) & 0xff] ^
+              table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24] ^
+              table[3][hi & 0xff] ^ table[2][(hi >> 8) & 0xff] ^
+              table[1][(hi >> 16) & 0xff] ^ table[0][hi >> 24];
+    }
+    while (len-- > 0)
+        crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xff];
+    return ~crc;
+}
+
+static unsigned int crc32c_sliced(unsigned int crc, const unsigned char *p,
+                                  size_t len)
+{
+    return crc_sliced(crc32c_table, crc, p, len);
+}
+
+#define ROTR(x, n)      ((x) >> (n) | (x) << (32 - (n)))
+
+static void sha256_blocks_portable(unsigned int state[8],
+                                   const unsigned char *p, size_t blocks)
+{
+    unsigned int w[64], s[8], t1, t2;
+    int i;
+
+    for (; blocks > 0; blocks--, p += 64) {
+        for (i = 0; i < 16; i++)
+            w[i] = (unsigned int)p[4*i] << 24 | p[4*i+1] << 16 |
+                   p[4*i+2] << 8 | p[4*i+3];
+        for (i = 16; i < 64; i++)
+            w[i] = w[i-16] + w[i-7] +
+                   (ROTR(w[i-15], 7) ^ ROTR(w[i-15], 18) ^ w[i-15] >> 3) +
+                   (ROTR(w[i-2], 17) ^ ROTR(w[i-2], 19) ^ w[i-2] >> 10);
+
+        memcpy(s, state, sizeof(s));
+        for (i = 0; i < 64; i++) {
+            t1 = s[7] + (ROTR(s[4], 6) ^ ROTR(s[4], 11) ^ ROTR(s[4], 25)) +
+                 ((s[4] & s[5]) ^ (~s[4] & s[6])) + sha256_k[i] + w[i];
+            t2 = (ROTR(s[0], 2) ^ ROTR(s[0], 13) ^ ROTR(s[0], 22)) +
+                 ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+            memmove(s + 1, s, 7 * sizeof(*s));
+            s[4] += t1;
+            s[0] = t1 + t2;
+        }
+        for (i = 0; i < 8; i++)
+            state[i] += s[i];
+    }
+}
+
+#ifdef CHECKSUM_X86
+__attribute__((target("sse4.2")))
+static unsigned int crc32c_sse42(unsigned int crc, const unsigned char *p,
+                                 size_t len)
+{
+    unsigned long long c = ~crc, v;
+
+    for (; len >= 8; p += 8, len -= 8) {
+        memcpy(&v, p, sizeof(v));
+        c = _mm_crc32_u64(c, v);
+    }
+    while (len-- > 0)
+        c = _mm_crc32_u8((unsigned int)c, *p++);
+    return ~(unsigned int)c;
+}
+
+__attribute__((target("sha,sse4.1")))
+static void sha256_blocks_shani(unsigned int state[8],
+                                const unsigned char *p, size_t blocks)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                         0x0405060700010203ULL);
+    __m128i abef, cdgh, abef_save, cdgh_save, tmp, msg, w[16];
+    int i;
+
+    /* the state is held as ABEF and CDGH words */
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0xb1);
+    cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(state + 4)),
+                             0x1b);
+    abef = _mm_alignr_epi8(tmp, cdgh, 8);
+    cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+    for (; blocks > 0; blocks--, p += 64) {
+        abef_save = abef;
+        cdgh_save = cdgh;
+        /* four rounds at a time, with the message schedule */
+        for (i = 0; i < 16; i++) {
+            if (i < 4)
+                w[i] = _mm_shuffle_epi8(
+                           _mm_loadu_si128((const __m128i *)(p + 16 * i)),
+                           bswap);
+            else
+                w[i] = _mm_sha256msg2_epu32(
+                           _mm_add_epi32(_mm_sha256msg1_epu32(w[i-4],
+                                                              w[i-3]),
+                                         _mm_alignr_epi8(w[i-1], w[i-2],
+                                                         4)),
+                           w[i-1]);
+            msg = _mm_add_epi32(w[i], _mm_loadu_si128(
+                                          (const __m128i *)(sha256_k +
+                                                            4 * i)));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh,
+                                         _mm_shuffle_epi32(msg, 0x0e));
+        }
+        abef = _mm_add_epi32(abef, abef_save);
+        cdgh = _mm_add_epi32(cdgh, cdgh_save);
+    }
+
+    tmp = _mm_shuffle_epi32(abef, 0x1b);
+    cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+    _mm_storeu_si128((__m128i *)state, _mm_blend_epi16(tmp, cdgh, 0xf0));
+    _mm_storeu_si128((__m128i *)(state + 4), _mm_alignr_epi8(cdgh, tmp, 8));
+}
+#endif
+
+static void checksums_setup(void)
+{
+#ifdef CHECKSUM_X86
+    unsigned int a, b, c, d;
+#endif
+
+    build_table(crc32_table, CRC32_POLY);
+    build_table(crc32c_table, CRC32C_POLY);
+    crc32c_update = crc32c_sliced;
+    sha256_blocks = sha256_blocks_portable;
+#ifdef CHECKSUM_X86
+    if (__get_cpuid(1, &a, &b, &c, &d) && (c & bit_SSE4_2))
+        crc32c_update = crc32c_sse42;
+    if (__get_cpuid(1, &a, &b, &c, &d) && (c & bit_SSE4_1) &&
+        __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & bit_SHA))
+        sha256_blocks = sha256_blocks_shani;
+#endif
+    tables_ready = 1;
+}
+
+void checksums_init(struct checksums *cs, int kinds)
+{
+    if (tables_ready == 0)
+        checksums_setup();
+    cs->kinds = kinds;
+    cs->crc32 = 0;
+    cs->crc32c = 0;
+    memcpy(cs->sha256, sha256_init, sizeof(cs->sha256));
+    cs->block_len = 0;
+    cs->length = 0;
+}
+
+void checksums_update(struct checksums *cs, const unsigned char *data,
+                      size_t len)
+{
+    size_t n;
+
+    cs->length += len;
+    if (cs->kinds & CHECKSUM_CRC32)
+        cs->crc32 = crc_sliced(crc32_table, cs->crc32, data, len);
+    if (cs->kinds & CHECKSUM_CRC32C)
+        cs->crc32c = crc32c_update(cs->crc32c, data, len);
+    if ((cs->kinds & CHECKSUM_SHA256) == 0)
+        return;
+
+    /* whole blocks are digested in place, the rest is kept for later */
+    if (cs->block_len > 0) {
+        n = 64 - cs->block_len < len ? 64 - cs->block_len : len;
+        memcpy(cs->block + cs->block_len, data, n);
+        cs->block_len += n;
+        data += n;
+        len -= n;
+        if (cs->block_len < 64)
+            return;
+        sha256_blocks(cs->sha256, cs->block, 1);
+        cs->block_len = 0;
+    }
+    if (len >= 64)
+        sha256_blocks(cs->sha256, data, len / 64);
+    memcpy(cs->block, data + len / 64 * 64, len % 64);
+    cs->block_len = len % 64;
+}
+
+void checksums_final(struct checksums *cs)
+{
+    unsigned long long bits = cs->length * 8;
+    int i;
+
+    if ((cs->kinds & CHECKSUM_SHA256) == 0)
+        return;
+
+    /* a one bit, zeros, and the length in bits in the last 8 bytes */
+    cs->block[cs->block_len++] = 0x80;
+    if (cs->block_len > 56) {
+        memset(cs->block + cs->block_len, 0, 64 - cs->block_len);
+        sha256_blocks(cs->sha256, cs->block, 1);
+        cs->block_len = 0;
+    }
+    memset(cs->block + cs->block_len, 0, 56 - cs->block_len);
+    for (i = 0; i < 8; i++)
+        cs->block[63 - i] = bits >> (8 * i);
+    sha256_blocks(cs->sha256, cs->block, 1);
+    cs->block_len = 0;
+}
+
+void checksum_format(const struct checksums *cs, int kind, char *text)
+{
+    int i;
+
+    switch (kind) {
+        case CHECKSUM_CRC32:
+            snprintf(text, CHECKSUM_TEXT_SIZE, "%08x", cs->crc32);
+            break;
+        case CHECKSUM_CRC32C:
+            snprintf(text, CHECKSUM_TEXT_SIZE, "%08x", cs->crc32c);
+            break;
+        case CHECKSUM_SHA256:
+            for (i = 0; i < 8; i++)
+                snprintf(text + 8 * i, CHECKSUM_TEXT_SIZE - 8 * i, "%08x",
+                         cs->sha256[i]);
+            break;
+        default:
+            text[0] = '\0';
+    }
+}
@@ -0,0 +1,390 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * decompress.c - streaming input decompression
+ *
+ * Input files compressed with gzip, xz or zstd are recognized by their magic
+ * bytes and decompressed on the fly: a thread decompresses the file into a
+ * pipe, whose other end replaces the file descriptor of the input. Readers
+ * see a stream of unknown size, and decompression runs in parallel with
+ * whatever processes its output, without any temporary file.
+ *
+ * Each format is only available if its library was found at build time.
+ * Errors of the decompressor are not fatal in its thread: it just closes the
+ * pipe, and the reader collects them with decompress_finish() once it sees
+ * the end-of-file.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "include/alloc.h"
+#include "include/decompress.h"
+
+/* decompression of a file into a pipe */
+struct decompress_job {
+    int format;
+    int in;                     /* compressed file */
+    int out;                    /* pipe write end */
+    int fd;                     /* pipe read end, handed to the reader */
+    unsigned char *ibuf;
+    unsigned char *obuf;
+    const char *error;          /* first error met, NULL if none */
+    pthread_t thread;
+    struct decompress_job *next;
+};
+
+static int decompression_enabled = 1;
+
+/* running decompressors, until their reader collects them */
+static struct decompress_job *jobs;
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void set_decompression(int enabled)
+{
+    decompression_enabled = enabled;
+}
+
+int detect_compression(const unsigned char *data, size_t len)
+{
+    if (len >= 2 && data[0] == 0x1f && data[1] == 0x8b)
+        return COMPRESSION_GZIP;
+    if (len >= 6 && memcmp(data, "\xfd" "7zXZ\0", 6) == 0)
+        return COMPRESSION_XZ;
+    if (len >= 4 && memcmp(data, "\x28\xb5\x2f\xfd", 4) == 0)
+        return COMPRESSION_ZSTD;
+    return COMPRESSION_NONE;
+}
+
+const char *compression_name(int format)
+{
+    static const char *names[] = { "plain", "gzip", "xz", "zstd" };
+
+    return names[format];
+}
+
+static int compression_supported(int format)
+{
+    switch (format) {
+#ifdef HAVE_ZLIB
+        case COMPRESSION_GZIP: return 1;
+#endif
+#ifdef HAVE_LZMA
+        case COMPRESSION_XZ: return 1;
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESSION_ZSTD: return 1;
+#endif
+        default: return 0;
+    }
+}
+
+#if defined(HAVE_ZLIB) || defined(HAVE_LZMA) || defined(HAVE_ZSTD)
+static void decompress_error(struct decompress_job *job, const char *what)
+{
+    /* the first error is the one worth reporting */
+    if (job->error == NULL)
+        job->error = what;
+}
+
+static ssize_t read_input(struct decompress_job *job)
+{
+    ssize_t n;
+
+    do {
+        n = read(job->in, job->ibuf, DECOMPRESS_BUFFER_SIZE);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0)
+        decompress_error(job, "cannot read");
+    return n;
+}
+
+static int write_output(struct decompress_job *job, size_t len)
+{
+    const unsigned char *p = job->obuf;
+    ssize_t n;
+
+    /* a closed pipe means the reader is done, there's no error to report */
+    while (len > 0) {
+        n = write(job->out, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+#endif
+
+#ifdef HAVE_ZLIB
+static void inflate_gzip(struct decompress_job *job)
+{
+    z_stream zs;
+    int ret, members = 0, pending = 0;
+    ssize_t n = -1;
+
+    memset(&zs, 0, sizeof(zs));
+    /* 32 lets zlib accept both gzip and zlib headers */
+    if (inflateInit2(&zs, 15 + 32) != Z_OK) {
+        decompress_error(job, "cannot decompress");
+        return;
+    }
+
+    for (;;) {
+        /* a full output buffer may leave more to flush before reading */
+        if (zs.avail_in == 0 && !pending) {
+            n = read_input(job);
+            if (n <= 0)
+                break;
+            zs.next_in = job->ibuf;
+            zs.avail_in = n;
+        }
+        zs.next_out = job->obuf;
+        zs.avail_out = DECOMPRESS_BUFFER_SIZE;
+        ret = inflate(&zs, Z_NO_FLUSH);
+        /* trailing garbage after a member is ignored, as gzip(1) does */
+        if (ret == Z_DATA_ERROR && members > 0 && zs.total_out == 0) {
+            zs.total_in = 0;
+            break;
+        }
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            decompress_error(job, "invalid");
+            break;
+        }
+        pending = zs.avail_out == 0;
+        if (write_output(job, DECOMPRESS_BUFFER_SIZE - zs.avail_out) < 0)
+            break;
+        /* concatenated members are decompressed one after the other */
+        if (ret == Z_STREAM_END) {
+            members++;
+            inflateReset(&zs);
+        }
+    }
+    /* the input ended in the middle of a member */
+    if (n == 0 && zs.total_in > 0)
+        decompress_error(job, "truncated");
+    inflateEnd(&zs);
+}
+#endif
+
+#ifdef HAVE_LZMA
+static void decode_xz(struct decompress_job *job)
+{
+    lzma_stream strm = LZMA_STREAM_INIT;
+    lzma_action action = LZMA_RUN;
+    lzma_ret ret;
+    ssize_t n;
+
+    if (lzma_stream_decoder(&strm, UINT64_MAX, LZMA_CONCATENATED) !=
+        LZMA_OK) {
+        decompress_error(job, "cannot decompress");
+        return;
+    }
+
+    for (;;) {
+        if (strm.avail_in == 0 && action == LZMA_RUN) {
+            n = read_input(job);
+            if (n < 0)
+                break;
+            if (n == 0)
+                action = LZMA_FINISH;
+            strm.next_in = job->ibuf;
+            strm.avail_in = n;
+        }
+        strm.next_out = job->obuf;
+        strm.avail_out = DECOMPRESS_BUFFER_SIZE;
+        ret = lzma_code(&strm, action);
+        if (ret != LZMA_OK && ret != LZMA_STREAM_END) {
+            decompress_error(job, ret == LZMA_BUF_ERROR ? "truncated"
+                                                        : "invalid");
+            break;
+        }
+        if (write_output(job, DECOMPRESS_BUFFER_SIZE - strm.avail_out) < 0)
+            break;
+        if (ret == LZMA_STREAM_END)
+            break;
+    }
+    lzma_end(&strm);
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static void decompress_zstd(struct decompress_job *job)
+{
+    ZSTD_DStream *ds = ZSTD_createDStream();
+    ZSTD_inBuffer in = { job->ibuf, 0, 0 };
+    ZSTD_outBuffer out;
+    size_t ret = 0;
+    ssize_t n = -1;
+
+    if (ds == NULL || ZSTD_isError(ZSTD_initDStream(ds))) {
+        decompress_error(job, "cannot decompress");
+        ZSTD_freeDStream(ds);
+        return;
+    }
+
+    for (;;) {
+        /* a full output buffer may leave more to flush before reading */
+        if (in.pos == in.size && (ret == 0 || out.pos < out.size)) {
+            n = read_input(job);
+            if (n <= 0)
+                break;
+            in.size = n;
+            in.pos = 0;
+        }
+        out.dst = job->obuf;
+        out.size = DECOMPRESS_BUFFER_SIZE;
+        out.pos = 0;
+        ret = ZSTD_decompressStream(ds, &out, &in);
+        if (ZSTD_isError(ret)) {
+            decompress_error(job, "invalid");
+            break;
+        }
+        if (write_output(job, out.pos) < 0)
+            break;
+    }
+    /* a frame was left incomplete */
+    if (n == 0 && ret != 0)
+        decompress_error(job, "truncated");
+    ZSTD_freeDStream(ds);
+}
+#endif
+
+static void *decompress_thread(void *arg)
+{
+    struct decompress_job *job = arg;
+
+    switch (job->format) {
+#ifdef HAVE_ZLIB
+        case COMPRESSION_GZIP: inflate_gzip(job); break;
+#endif
+#ifdef HAVE_LZMA
+        case COMPRESSION_XZ: decode_xz(job); break;
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESSION_ZSTD: decompress_zstd(job); break;
+#endif
+    }
+
+    /* the reader sees the end-of-file once the pipe is closed */
+    close(job->out);
+    close(job->in);
+    free(job->ibuf);
+    free(job->obuf);
+    return NULL;
+}
+
+int decompress_finish(int fd, char *error, size_t size)
+{
+    struct decompress_job **p, *job = NULL;
+    int ret = 0;
+
+    pthread_mutex_lock(&jobs_lock);
+    for (p = &jobs; *p != NULL; p = &(*p)->next) {
+        if ((*p)->fd == fd) {
+            job = *p;
+            *p = job->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&jobs_lock);
+
+    /* not a decompressor pipe */
+    if (job == NULL)
+        return 0;
+
+    pthread_join(job->thread, NULL);
+    if (job->error != NULL) {
+        snprintf(error, size, "%s %s data", job->error,
+                 compression_name(job->format));
+        ret = -1;
+    }
+    free(job);
+    return ret;
+}
+
+int decompress_fd(const char *filename, int fd)
+{
+    unsigned char magic[6];
+    struct decompress_job *job;
+    struct stat st;
+    int fds[2], format;
+    ssize_t n;
+
+    /* only regular files can be peeked at without consuming them */
+    if (!decompression_enabled || fstat(fd, &st) != 0 ||
+        !S_ISREG(st.st_mode))
+        return fd;
+    n = pread(fd, magic, sizeof(magic), 0);
+    format = detect_compression(magic, n > 0 ? n : 0);
+    if (format == COMPRESSION_NONE)
+        return fd;
+    if (!compression_supported(format)) {
+        fprintf(stderr, "[-] Warning: \"%s\" is %s compressed, but %s "
+                "support isn't built in.\n", filename,
+                compression_name(format), compression_name(format));
+        return fd;
+    }
+
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        perror("pipe2");
+        exit(EXIT_FAILURE);
+    }
+    /* a larger pipe lets the decompressor run further ahead */
+    fcntl(fds[1], F_SETPIPE_SZ, DECOMPRESS_PIPE_SIZE);
+
+    job = (struct decompress_job *)allocate_dynamic_memory(sizeof(*job));
+    job->format = format;
+    job->in = fd;
+    job->out = fds[1];
+    job->fd = fds[0];
+    job->error = NULL;
+    job->ibuf = (unsigned char *)allocate_dynamic_memory(
+                    DECOMPRESS_BUFFER_SIZE);
+    job->obuf = (unsigned char *)allocate_dynamic_memory(
+                    DECOMPRESS_BUFFER_SIZE);
+    if (pthread_create(&job->thread, NULL, decompress_thread, job) != 0) {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_lock(&jobs_lock);
+    job->next = jobs;
+    jobs = job;
+    pthread_mutex_unlock(&jobs_lock);
+
+    return fds[0];
+}
@@ -0,0 +1,383 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * dumpfmt.c - textual dump formats parser
+ *
+ * Outputs of xxd, hexdump -C, objdump -d and gdb's x/x command mix offsets,
+ * bytes and ASCII or disassembly columns. Each line is parsed according to
+ * the layout of its format so only the byte columns are extracted. Values
+ * wider than a byte (gdb x/xw, objdump words) are stored in little-endian
+ * order.
+ */
+
+#include <string.h>
+#include <ctype.h>
+#include "include/dumpfmt.h"
+
+#define DETECT_MAX_LINES    100     /* lines looked at to detect a format */
+#define DETECT_MAX_BYTES    65536   /* input bytes looked at likewise */
+
+static const char *format_names[] = {
+    "hex", "xxd", "hexdump", "objdump", "gdb"
+};
+
+static int hexval(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static const char * skip_hex(const char *p, const char *e)
+{
+    while (p < e && hexval(*p) >= 0)
+        p++;
+    return p;
+}
+
+static const char * skip_blanks(const char *p, const char *e)
+{
+    while (p < e && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+int dump_format_from_name(const char *name)
+{
+    int i;
+
+    if (strcmp(name, "auto") == 0)
+        return DUMP_AUTO;
+    for (i = DUMP_PLAIN; i <= DUMP_GDB; i++) {
+        if (strcmp(name, format_names[i]) == 0)
+            return i;
+    }
+    return -2;
+}
+
+const char * dump_format_name(int format)
+{
+    if (format < DUMP_PLAIN || format > DUMP_GDB)
+        return "auto";
+    return format_names[format];
+}
+
+static void put_byte(struct dump_parser *dp, unsigned char c)
+{
+    if (dp->len == DUMP_BUFFER_SIZE) {
+        dp->fn(dp->ctx, dp->buf, dp->len);
+        dp->len = 0;
+    }
+    dp->buf[dp->len++] = c;
+}
+
+static void put_value(struct dump_parser *dp, const char *p, size_t digits)
+{
+    size_t i;
+
+    /* a value of 'digits' hex digits, least significant byte first */
+    for (i = digits; i >= 2; i -= 2)
+        put_byte(dp, hexval(p[i-2]) << 4 | hexval(p[i-1]));
+}
+
+static int is_value_width(size_t digits)
+{
+    return digits == 2 || digits == 4 || digits == 8 || digits == 16;
+}
+
+static void parse_xxd_line(struct dump_parser *dp, const char *p,
+                           const char *e)
+{
+    /* "00000000: 7f45 4c46 0201 0100  .ELF...." */
+    p = skip_hex(p, e);
+    if (p == e || *p != ':')
+        return;
+    for (p++; p < e; ) {
+        if (*p == ' ') {
+            /* two spaces separate the bytes from the ASCII column */
+            if (p + 1 < e && p[1] == ' ')
+                break;
+            p++;
+        } else if (p + 1 < e && hexval(p[0]) >= 0 && hexval(p[1]) >= 0) {
+            put_value(dp, p, 2);
+            p += 2;
+        } else {
+            break;
+        }
+    }
+}
+
+static void parse_hexdump_line(struct dump_parser *dp, const char *p,
+                               const char *e)
+{
+    /* "00000000  7f 45 4c 46 02 01 01 00  00 00 00 00  |.ELF........|" */
+    unsigned char line[DUMP_BUFFER_SIZE];
+    unsigned long long offset = 0;
+    size_t len = 0, n;
+
+    if (p < e && *p == '*') {
+        dp->squeezed = 1;
+        return;
+    }
+    if (skip_hex(p, e) == p)
+        return;
+    for (; p < e && hexval(*p) >= 0; p++)
+        offset = offset << 4 | hexval(*p);
+
+    /* a squeezed line stands for copies of the previous line up to the
+     * offset of the current one.
+     */
+    if (dp->squeezed && dp->prev_len > 0) {
+        while (dp->next_offset + dp->prev_len <= offset) {
+            for (n = 0; n < dp->prev_len; n++)
+                put_byte(dp, dp->prev[n]);
+            dp->next_offset += dp->prev_len;
+        }
+    }
+    dp->squeezed = 0;
+
+    /* the bytes of the line are collected on their own, the output buffer
+     * may be flushed while they are put in it.
+     */
+    for (;;) {
+        p = skip_blanks(p, e);
+        if (p + 1 >= e || *p == '|' || hexval(p[0]) < 0 || hexval(p[1]) < 0 ||
+            len == sizeof(line))
+            break;
+        line[len++] = hexval(p[0]) << 4 | hexval(p[1]);
+        p += 2;
+    }
+    for (n = 0; n < len; n++)
+        put_byte(dp, line[n]);
+
+    /* remember the line for a following '*' */
+    if (len > 0) {
+        memcpy(dp->prev, line, len);
+        dp->prev_len = len;
+        dp->next_offset = offset + len;
+    }
+}
+
+static void parse_objdump_line(struct dump_parser *dp, const char *p,
+                               const char *e)
+{
+    /* "  401000:\t48 89 e5             \tmov    %rsp,%rbp" */
+    const char *q;
+
+    p = skip_blanks(p, e);
+    q = skip_hex(p, e);
+    if (q == p || q + 1 >= e || q[0] != ':' || q[1] != '\t')
+        return;
+    for (p = q + 2; p < e && *p != '\t'; ) {
+        if (*p == ' ') {
+            p++;
+            continue;
+        }
+        q = skip_hex(p, e);
+        if (!is_value_width(q - p) || (q < e && *q != ' ' && *q != '\t'))
+            break;
+        put_value(dp, p, q - p);
+        p = q;
+    }
+}
+
+static void parse_gdb_line(struct dump_parser *dp, const char *p,
+                           const char *e)
+{
+    /* "0x401000 <main+4>:\t0x55\t0x48\t0x89\t0xe5" */
+    const char *q;
+
+    if (e - p < 3 || p[0] != '0' || p[1] != 'x')
+        return;
+    p = skip_hex(p + 2, e);
+    if (p < e && *p == ' ') {
+        /* symbol and offset, closed by ">:" */
+        for (q = p; q + 1 < e && !(q[0] == '>' && q[1] == ':'); q++)
+            ;
+        p = q + 1;
+    }
+    if (p >= e || *p != ':')
+        return;
+    for (p++; ; p = q) {
+        p = skip_blanks(p, e);
+        if (e - p < 3 || p[0] != '0' || p[1] != 'x')
+            break;
+        q = skip_hex(p + 2, e);
+        if (!is_value_width(q - p - 2))
+            break;
+        put_value(dp, p + 2, q - p - 2);
+    }
+}
+
+static int line_format(const char *p, const char *e)
+{
+    const char *q;
+
+    /* gdb: "0x401000 <main>:\t0x55" */
+    if (e - p > 2 && p[0] == '0' && p[1] == 'x') {
+        q = skip_hex(p + 2, e);
+        if (q < e && *q == ' ' && q + 1 < e && q[1] == '<') {
+            while (q + 1 < e && !(q[0] == '>' && q[1] == ':'))
+                q++;
+            q++;
+        }
+        if (q < e && *q == ':') {
+            q = skip_blanks(q + 1, e);
+            if (e - q > 2 && q[0] == '0' && q[1] == 'x')
+                return DUMP_GDB;
+        }
+    }
+
+    /* objdump: "  401000:\t48 89 e5" */
+    q = skip_hex(skip_blanks(p, e), e);
+    if (q > skip_blanks(p, e) && e - q > 3 && q[0] == ':' && q[1] == '\t' &&
+        hexval(q[2]) >= 0 && hexval(q[3]) >= 0)
+        return DUMP_OBJDUMP;
+
+    /* xxd: "00000000: 7f45" */
+    q = skip_hex(p, e);
+    if (q - p >= 4 && e - q > 2 && q[0] == ':' && q[1] == ' ' &&
+        hexval(q[2]) >= 0)
+        return DUMP_XXD;
+
+    /* hexdump -C: "00000000  7f 45 ... |.ELF|" */
+    if (q - p >= 8 && e - q > 4 && q[0] == ' ' && q[1] == ' ' &&
+        hexval(q[2]) >= 0 && hexval(q[3]) >= 0 && q[4] == ' ' &&
+        memchr(q, '|', e - q) != NULL)
+        return DUMP_HEXDUMP;
+
+    return DUMP_PLAIN;
+}
+
+static int is_plain_line(const char *p, const char *e)
+{
+    int digits = 0;
+
+    /* hex digits with separators and escapes ("41 42", "\x41\x42",
+     * "0x41, 0x42"), without the words or colons of dumps headers.
+     */
+    for (; p < e; p++) {
+        if (hexval(*p) >= 0)
+            digits++;
+        else if (*p == ':' || (isalpha((unsigned char)*p) &&
+                               *p != 'x' && *p != 'X'))
+            return 0;
+    }
+    return digits > 0;
+}
+
+static int detect_format(const char *text, size_t len, int complete)
+{
+    const char *p = text, *e, *eol, *end;
+    int lines, format;
+
+    /* dump formats are recognizable from their first lines, so there is no
+     * need to look further on large inputs or very long lines.
+     */
+    e = text + (len < DETECT_MAX_BYTES ? len : DETECT_MAX_BYTES);
+
+    for (lines = 0; p < e && lines < DETECT_MAX_LINES; lines++, p = eol + 1) {
+        eol = memchr(p, '\n', e - p);
+        if (eol == NULL) {
+            /* the last line of an incomplete input may be cut short */
+            if (!complete)
+                break;
+            eol = e;
+        }
+        end = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+        format = line_format(p, end);
+        if (format != DUMP_PLAIN)
+            return format;
+        /* a line of bare hex digits means plain hexadecimal input */
+        if (end > p && skip_hex(skip_blanks(p, end), end) == end)
+            return DUMP_PLAIN;
+        /* so does any whole line of digits without dump structure, while
+         * the input is incomplete
+         */
+        if (!complete && is_plain_line(p, end))
+            return DUMP_PLAIN;
+    }
+
+    /* more lines of an incomplete input may still tell */
+    if (!complete && lines < DETECT_MAX_LINES && len < DETECT_MAX_BYTES)
+        return DUMP_AUTO;
+    return DUMP_PLAIN;
+}
+
+int detect_dump_format(const char *text, size_t len)
+{
+    return detect_format(text, len, 1);
+}
+
+int detect_dump_format_prefix(const char *text, size_t len)
+{
+    /* DUMP_AUTO until the first lines of the input are conclusive */
+    return detect_format(text, len, 0);
+}
+
+void dump_parser_init(struct dump_parser *dp, int format, dump_bytes_fn fn,
+                      void *ctx)
+{
+    memset(dp, 0, sizeof(*dp));
+    dp->format = format;
+    dp->fn = fn;
+    dp->ctx = ctx;
+}
+
+void dump_parser_feed(struct dump_parser *dp, const char *text, size_t len)
+{
+    const char *p = text, *e, *eol, *end;
+
+    /* the input may end with a null terminator */
+    while (len > 0 && text[len-1] == '\0')
+        len--;
+    e = text + len;
+
+    for (; p < e; p = eol + 1) {
+        eol = memchr(p, '\n', e - p);
+        if (eol == NULL)
+            eol = e;
+        /* ignore the carriage return of CRLF line endings */
+        end = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+        switch (dp->format) {
+            case DUMP_XXD: parse_xxd_line(dp, p, end); break;
+            case DUMP_HEXDUMP: parse_hexdump_line(dp, p, end); break;
+            case DUMP_OBJDUMP: parse_objdump_line(dp, p, end); break;
+            case DUMP_GDB: parse_gdb_line(dp, p, end); break;
+        }
+    }
+
+    /* the bytes of the lines fed so far are all handed out */
+    if (dp->len > 0)
+        dp->fn(dp->ctx, dp->buf, dp->len);
+    dp->len = 0;
+}
+
+void parse_dump(int format, const char *text, size_t len, dump_bytes_fn fn,
+                void *ctx)
+{
+    struct dump_parser dp;
+
+    dump_parser_init(&dp, format, fn, ctx);
+    dump_parser_feed(&dp, text, len);
+}
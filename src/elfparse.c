@@ -0,0 +1,302 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * elfparse.c - ELF sections and symbols lookup
+ *
+ * Headers are read in place from the mapped file, so a section or symbol
+ * can be dumped without extracting it first (as with objcopy). Both 32 and
+ * 64-bit classes are supported in either byte order, independently of the
+ * host's, and every offset read from the file is checked against its size.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <elf.h>
+#include "include/elfparse.h"
+
+/* ELF file being parsed */
+struct elf_file {
+    const unsigned char *data;
+    size_t size;
+    int is64;                   /* ELFCLASS64 */
+    int msb;                    /* big-endian file (ELFDATA2MSB) */
+    int type;                   /* e_type */
+    uint64_t shoff;             /* section header table offset */
+    uint64_t shentsize;         /* section header entry size */
+    uint64_t shnum;             /* number of section headers */
+    uint64_t shstrndx;          /* section names string table index */
+};
+
+/* class independent section header */
+struct elf_section {
+    uint32_t name;
+    uint32_t type;
+    uint64_t addr;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t link;
+    uint64_t entsize;
+};
+
+static uint64_t get_field(const struct elf_file *ef, uint64_t offset,
+                          int len)
+{
+    uint64_t value = 0;
+    int i;
+
+    /* read a 'len' bytes integer in the byte order of the file, most
+     * significant byte first.
+     */
+    for (i = 0; i < len; i++)
+        value = value << 8 | ef->data[offset + (ef->msb ? i : len - 1 - i)];
+    return value;
+}
+
+static int in_file(const struct elf_file *ef, uint64_t offset, uint64_t len)
+{
+    return offset <= ef->size && len <= ef->size - offset;
+}
+
+static int read_section(const struct elf_file *ef, uint64_t index,
+                        struct elf_section *sh)
+{
+    uint64_t p = ef->shoff + index * ef->shentsize;
+
+    if (index >= ef->shnum && !(index == 0 && ef->shnum == 0))
+        return ELF_ERR_FORMAT;
+    if (!in_file(ef, p, ef->is64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr)))
+        return ELF_ERR_FORMAT;
+
+    if (ef->is64) {
+        sh->name = get_field(ef, p + offsetof(Elf64_Shdr, sh_name), 4);
+        sh->type = get_field(ef, p + offsetof(Elf64_Shdr, sh_type), 4);
+        sh->addr = get_field(ef, p + offsetof(Elf64_Shdr, sh_addr), 8);
+        sh->offset = get_field(ef, p + offsetof(Elf64_Shdr, sh_offset), 8);
+        sh->size = get_field(ef, p + offsetof(Elf64_Shdr, sh_size), 8);
+        sh->link = get_field(ef, p + offsetof(Elf64_Shdr, sh_link), 4);
+        sh->entsize = get_field(ef, p + offsetof(Elf64_Shdr, sh_entsize), 8);
+    } else {
+        sh->name = get_field(ef, p + offsetof(Elf32_Shdr, sh_name), 4);
+        sh->type = get_field(ef, p + offsetof(Elf32_Shdr, sh_type), 4);
+        sh->addr = get_field(ef, p + offsetof(Elf32_Shdr, sh_addr), 4);
+        sh->offset = get_field(ef, p + offsetof(Elf32_Shdr, sh_offset), 4);
+        sh->size = get_field(ef, p + offsetof(Elf32_Shdr, sh_size), 4);
+        sh->link = get_field(ef, p + offsetof(Elf32_Shdr, sh_link), 4);
+        sh->entsize = get_field(ef, p + offsetof(Elf32_Shdr, sh_entsize), 4);
+    }
+    return 0;
+}
+
+static int open_elf(struct elf_file *ef, const unsigned char *data,
+                    size_t size)
+{
+    struct elf_section sh0;
+
+    ef->data = data;
+    ef->size = size;
+
+    if (size < EI_NIDENT || memcmp(data, ELFMAG, SELFMAG) != 0)
+        return ELF_ERR_FORMAT;
+    if (data[EI_CLASS] != ELFCLASS32 && data[EI_CLASS] != ELFCLASS64)
+        return ELF_ERR_FORMAT;
+    if (data[EI_DATA] != ELFDATA2LSB && data[EI_DATA] != ELFDATA2MSB)
+        return ELF_ERR_FORMAT;
+
+    ef->is64 = data[EI_CLASS] == ELFCLASS64;
+    ef->msb = data[EI_DATA] == ELFDATA2MSB;
+    if (!in_file(ef, 0, ef->is64 ? sizeof(Elf64_Ehdr) : sizeof(Elf32_Ehdr)))
+        return ELF_ERR_FORMAT;
+
+    if (ef->is64) {
+        ef->type = get_field(ef, offsetof(Elf64_Ehdr, e_type), 2);
+        ef->shoff = get_field(ef, offsetof(Elf64_Ehdr, e_shoff), 8);
+        ef->shentsize = get_field(ef, offsetof(Elf64_Ehdr, e_shentsize), 2);
+        ef->shnum = get_field(ef, offsetof(Elf64_Ehdr, e_shnum), 2);
+        ef->shstrndx = get_field(ef, offsetof(Elf64_Ehdr, e_shstrndx), 2);
+    } else {
+        ef->type = get_field(ef, offsetof(Elf32_Ehdr, e_type), 2);
+        ef->shoff = get_field(ef, offsetof(Elf32_Ehdr, e_shoff), 4);
+        ef->shentsize = get_field(ef, offsetof(Elf32_Ehdr, e_shentsize), 2);
+        ef->shnum = get_field(ef, offsetof(Elf32_Ehdr, e_shnum), 2);
+        ef->shstrndx = get_field(ef, offsetof(Elf32_Ehdr, e_shstrndx), 2);
+    }
+    if (ef->shoff == 0 ||
+        ef->shentsize < (ef->is64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr)))
+        return ELF_ERR_FORMAT;
+
+    /* large section counts and indexes are stored in the first section */
+    if (ef->shnum == 0 || ef->shstrndx == SHN_XINDEX) {
+        if (read_section(ef, 0, &sh0) < 0)
+            return ELF_ERR_FORMAT;
+        if (ef->shnum == 0)
+            ef->shnum = sh0.size;
+        if (ef->shstrndx == SHN_XINDEX)
+            ef->shstrndx = sh0.link;
+    }
+    if (ef->shoff > ef->size || ef->shnum > (ef->size - ef->shoff) /
+                                            ef->shentsize)
+        return ELF_ERR_FORMAT;
+
+    return 0;
+}
+
+static const char * get_string(const struct elf_file *ef,
+                               const struct elf_section *strtab,
+                               uint64_t index)
+{
+    /* null-terminated string at 'index' of a string table, if valid */
+    if (strtab->type != SHT_STRTAB || index >= strtab->size ||
+        !in_file(ef, strtab->offset, strtab->size))
+        return NULL;
+    if (memchr(ef->data + strtab->offset + index, '\0',
+               strtab->size - index) == NULL)
+        return NULL;
+    return (const char *)ef->data + strtab->offset + index;
+}
+
+int elf_find_section(const unsigned char *data, size_t size,
+                     const char *name, struct elf_range *range)
+{
+    struct elf_file ef;
+    struct elf_section sh, shstrtab;
+    const char *s;
+    uint64_t i;
+    int error;
+
+    if ((error = open_elf(&ef, data, size)) < 0)
+        return error;
+    if (read_section(&ef, ef.shstrndx, &shstrtab) < 0)
+        return ELF_ERR_FORMAT;
+
+    for (i = 0; i < ef.shnum; i++) {
+        if (read_section(&ef, i, &sh) < 0)
+            return ELF_ERR_FORMAT;
+        s = get_string(&ef, &shstrtab, sh.name);
+        if (s == NULL || strcmp(s, name) != 0)
+            continue;
+
+        if (sh.type == SHT_NOBITS)
+            return ELF_ERR_NOBITS;
+        if (!in_file(&ef, sh.offset, sh.size))
+            return ELF_ERR_FORMAT;
+        range->offset = sh.offset;
+        range->size = sh.size;
+        return 0;
+    }
+
+    return ELF_ERR_NOTFOUND;
+}
+
+static int find_in_symtab(const struct elf_file *ef,
+                          const struct elf_section *symtab,
+                          const char *name, struct elf_range *range)
+{
+    struct elf_section strtab, sh;
+    uint64_t i, p, value, symsize, count;
+    unsigned int shndx;
+    const char *s;
+
+    if (read_section(ef, symtab->link, &strtab) < 0 ||
+        !in_file(ef, symtab->offset, symtab->size) || symtab->entsize <
+        (ef->is64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym)))
+        return ELF_ERR_FORMAT;
+
+    count = symtab->size / symtab->entsize;
+    for (i = 0; i < count; i++) {
+        p = symtab->offset + i * symtab->entsize;
+        if (ef->is64) {
+            s = get_string(ef, &strtab,
+                           get_field(ef, p + offsetof(Elf64_Sym, st_name), 4));
+            shndx = get_field(ef, p + offsetof(Elf64_Sym, st_shndx), 2);
+            value = get_field(ef, p + offsetof(Elf64_Sym, st_value), 8);
+            symsize = get_field(ef, p + offsetof(Elf64_Sym, st_size), 8);
+        } else {
+            s = get_string(ef, &strtab,
+                           get_field(ef, p + offsetof(Elf32_Sym, st_name), 4));
+            shndx = get_field(ef, p + offsetof(Elf32_Sym, st_shndx), 2);
+            value = get_field(ef, p + offsetof(Elf32_Sym, st_value), 4);
+            symsize = get_field(ef, p + offsetof(Elf32_Sym, st_size), 4);
+        }
+        if (s == NULL || strcmp(s, name) != 0)
+            continue;
+
+        /* undefined, absolute and common symbols have no content */
+        if (shndx == SHN_UNDEF || shndx >= SHN_LORESERVE)
+            continue;
+        if (read_section(ef, shndx, &sh) < 0)
+            return ELF_ERR_FORMAT;
+        if (sh.type == SHT_NOBITS)
+            return ELF_ERR_NOBITS;
+
+        /* symbol values are section offsets in relocatable objects and
+         * virtual addresses otherwise.
+         */
+        if (ef->type != ET_REL) {
+            if (value < sh.addr)
+                return ELF_ERR_FORMAT;
+            value -= sh.addr;
+        }
+        if (value > sh.size || symsize > sh.size - value ||
+            !in_file(ef, sh.offset + value, symsize))
+            return ELF_ERR_FORMAT;
+        range->offset = sh.offset + value;
+        range->size = symsize;
+        return 0;
+    }
+
+    return ELF_ERR_NOTFOUND;
+}
+
+int elf_find_symbol(const unsigned char *data, size_t size,
+                    const char *name, struct elf_range *range)
+{
+    struct elf_file ef;
+    struct elf_section sh;
+    uint64_t i;
+    int error, pass;
+    unsigned int types[] = { SHT_SYMTAB, SHT_DYNSYM };
+
+    if ((error = open_elf(&ef, data, size)) < 0)
+        return error;
+
+    /* full symbol table first, then the dynamic one of stripped files */
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < ef.shnum; i++) {
+            if (read_section(&ef, i, &sh) < 0)
+                return ELF_ERR_FORMAT;
+            if (sh.type != types[pass])
+                continue;
+            error = find_in_symtab(&ef, &sh, name, range);
+            if (error != ELF_ERR_NOTFOUND)
+                return error;
+        }
+    }
+
+    return ELF_ERR_NOTFOUND;
+}
+
+const char * elf_strerror(int error)
+{
+    switch (error) {
+        case ELF_ERR_FORMAT: return "not a valid ELF file";
+        case ELF_ERR_NOTFOUND: return "not found";
+        case ELF_ERR_NOBITS: return "no content in the file";
+    }
+    return "unknown error";
+}
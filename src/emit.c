@@ -0,0 +1,546 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * emit.c - binary string syntax emitters
+ *
+ * An emitter formats bytes (or pairs of hexadecimal digits) as an escaped
+ * binary string in one of the supported output syntaxes, breaking lines
+ * every 'width' bytes. Output is accumulated in a buffer and handed over to
+ * a flush callback, which by default writes to a stdio stream.
+ *
+ * The decimal syntax is a list of byte values, each followed by a comma,
+ * meant to be included between the braces of an array initializer. It is
+ * much faster for compilers to parse than long string literals.
+ *
+ * Binary strings are either anonymous, declared as "buffer" in verbose
+ * mode, or complete arrays of the given name followed by their length.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "include/alloc.h"
+#include "include/emit.h"
+
+/* lowercase hexadecimal digits used to format binary input */
+static const char hex_digits[] = "0123456789abcdef";
+
+/* strings opening and closing a line of binary string for each syntax */
+static const char *line_open[] = { "", "\"", "buffer += \"", "" };
+static const char *line_close[] = { "", "\"", "\"", "" };
+/* variable declarations put ahead of the binary string in verbose mode */
+static const char *declaration[] = {
+    "", "unsigned char buffer[] =\n", "buffer =  \"\"\n", ""
+};
+
+static int hex_value(unsigned char c)
+{
+    return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+static char *format_decimal(char *p, unsigned char c)
+{
+    /* byte value in decimal followed by a comma, at most 4 characters */
+    if (c >= 100)
+        *p++ = '0' + c / 100;
+    if (c >= 10)
+        *p++ = '0' + c / 10 % 10;
+    *p++ = '0' + c % 10;
+    *p++ = ',';
+    return p;
+}
+
+void emit_flush_stream(void *ctx, const char *data, size_t len)
+{
+    /* default flush callback: write to the stdio stream in 'ctx' */
+    fwrite(data, sizeof(char), len, (FILE *)ctx);
+}
+
+void emit_init(struct emitter *em, int lang, int width)
+{
+    /* unknown syntaxes fall back to raw output */
+    if (lang < SYNTAX_RAW || lang > SYNTAX_DECIMAL)
+        lang = SYNTAX_RAW;
+
+    em->lang = lang;
+    em->width = width > 0 ? width : 0;
+    em->count = 0;
+    em->nibble = 0;
+    em->digit = 0;
+    em->invalid = 0;
+    em->size = EMIT_BUFFER_SIZE;
+    em->buf = allocate_dynamic_memory(em->size);
+    em->len = 0;
+    em->flush = emit_flush_stream;
+    em->ctx = stdout;
+    em->name = NULL;
+}
+
+void emit_free(struct emitter *em)
+{
+    emit_flush(em);
+    free(em->buf);
+    em->buf = NULL;
+}
+
+void emit_flush(struct emitter *em)
+{
+    if (em->len > 0) {
+        em->flush(em->ctx, em->buf, em->len);
+        em->len = 0;
+    }
+}
+
+void emit_write(struct emitter *em, const char *data, size_t len)
+{
+    /* copy 'data' to the output buffer, flushing it whenever it fills up */
+    while (len > 0) {
+        size_t n = em->size - em->len;
+
+        if (n == 0) {
+            emit_flush(em);
+            continue;
+        }
+        if (n > len)
+            n = len;
+        memcpy(em->buf + em->len, data, n);
+        em->len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+static void emit_string(struct emitter *em, const char *s)
+{
+    emit_write(em, s, strlen(s));
+}
+
+void emit_declaration(struct emitter *em)
+{
+    char text[256];
+    int n;
+
+    if (em->name == NULL) {
+        emit_string(em, declaration[em->lang]);
+        return;
+    }
+    switch (em->lang) {
+        case SYNTAX_C:
+            n = snprintf(text, sizeof(text), "unsigned char %s[] =\n",
+                         em->name);
+            break;
+        case SYNTAX_PYTHON:
+            n = snprintf(text, sizeof(text), "%s =  \"\"\n", em->name);
+            break;
+        case SYNTAX_DECIMAL:
+            n = snprintf(text, sizeof(text), "unsigned char %s[] = {\n",
+                         em->name);
+            break;
+        default:
+            return;
+    }
+    emit_write(em, text, (size_t)n < sizeof(text) ? n : sizeof(text) - 1);
+}
+
+void emit_comment(struct emitter *em, const char *fmt, ...)
+{
+    char text[256];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+
+    /* comments are only meaningful between two binary strings */
+    switch (em->lang) {
+        case SYNTAX_C:
+        case SYNTAX_DECIMAL:
+            emit_string(em, "/* ");
+            emit_string(em, text);
+            emit_string(em, " */\n");
+            break;
+        default:
+            emit_string(em, "# ");
+            emit_string(em, text);
+            emit_string(em, "\n");
+    }
+}
+
+static int emit_at_line_start(const struct emitter *em)
+{
+    /* the first byte of a string and of every 'width' bytes open a line */
+    return em->count == 0 ||
+           (em->width != 0 && em->count % em->width == 0);
+}
+
+static void emit_line_open(struct emitter *em)
+{
+    /* python lines are appended to the array variable */
+    if (em->lang == SYNTAX_PYTHON && em->name != NULL) {
+        emit_string(em, em->name);
+        emit_string(em, " += \"");
+    } else {
+        emit_string(em, line_open[em->lang]);
+    }
+}
+
+static void emit_line_start(struct emitter *em)
+{
+    /* close the previous line, if any, before opening a new one */
+    if (em->count != 0) {
+        emit_string(em, line_close[em->lang]);
+        emit_write(em, "\n", 1);
+    }
+    emit_line_open(em);
+}
+
+void emit_bytes(struct emitter *em, const unsigned char *data, size_t len)
+{
+    while (len > 0) {
+        /* number of bytes left on the current line */
+        size_t n = len;
+
+        if (emit_at_line_start(em))
+            emit_line_start(em);
+        if (em->width != 0 && n > em->width - em->count % em->width)
+            n = em->width - em->count % em->width;
+        em->count += n;
+        len -= n;
+
+        /* format the bytes as '\xNN' directly in the output buffer */
+        while (n > 0) {
+            size_t room = (em->size - em->len) / 4;
+            char *p = em->buf + em->len;
+
+            if (room == 0) {
+                emit_flush(em);
+                continue;
+            }
+            if (room > n)
+                room = n;
+            n -= room;
+            if (em->lang == SYNTAX_DECIMAL) {
+                while (room-- > 0)
+                    p = format_decimal(p, *data++);
+                em->len = p - em->buf;
+                continue;
+            }
+            em->len += room * 4;
+            while (room-- > 0) {
+                p[0] = '\\';
+                p[1] = 'x';
+                p[2] = hex_digits[*data >> 4];
+                p[3] = hex_digits[*data & 0x0f];
+                data++;
+                p += 4;
+            }
+        }
+    }
+}
+
+void emit_hex_digits(struct emitter *em, const unsigned char *data,
+                     size_t len)
+{
+    /* plain hexadecimal digits, without escapes nor line breaks */
+    while (len > 0) {
+        size_t room = (em->size - em->len) / 2;
+        char *p = em->buf + em->len;
+
+        if (room == 0) {
+            emit_flush(em);
+            continue;
+        }
+        if (room > len)
+            room = len;
+        em->len += room * 2;
+        len -= room;
+        while (room-- > 0) {
+            p[0] = hex_digits[*data >> 4];
+            p[1] = hex_digits[*data & 0x0f];
+            data++;
+            p += 2;
+        }
+    }
+}
+
+const unsigned char hex_class[256] = {
+    /* the end-of-file, the new-line and the null characters are silently
+     * skipped, anything else but hexadecimal digits is counted as invalid.
+     */
+    [0x00] = HEX_SKIPPED, ['\n'] = HEX_SKIPPED, [0xff] = HEX_SKIPPED,
+    ['0' ... '9'] = HEX_DIGIT,
+    ['A' ... 'F'] = HEX_DIGIT,
+    ['a' ... 'f'] = HEX_DIGIT,
+};
+
+void emit_hex_text(struct emitter *em, const char *text, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        unsigned char c = text[i];
+
+        /* fast path: whole pairs of digits in the middle of a line */
+        if (em->nibble == 0 && em->count != 0 &&
+            em->lang != SYNTAX_DECIMAL &&
+            !(em->width != 0 && em->count % em->width == 0)) {
+            size_t left = em->width ? em->width - em->count % em->width
+                                    : (size_t)-1;
+            size_t k = 0, room = (em->size - em->len) / 4;
+            char *p = em->buf + em->len;
+
+            if (left > room)
+                left = room;
+            while (k < left && i + 1 < len &&
+                   hex_class[(unsigned char)text[i]] == HEX_DIGIT &&
+                   hex_class[(unsigned char)text[i+1]] == HEX_DIGIT) {
+                p[0] = '\\';
+                p[1] = 'x';
+                p[2] = text[i];
+                p[3] = text[i+1];
+                p += 4;
+                i += 2;
+                k++;
+            }
+            em->len += k * 4;
+            em->count += k;
+        }
+        if (i >= len)
+            break;
+        c = text[i];
+
+        /* filter out any characters outside of the hexadecimal ASCII
+         * character range.
+         */
+        if (hex_class[c] != HEX_DIGIT) {
+            if (hex_class[c] == HEX_INVALID)
+                em->invalid++;
+            continue;
+        }
+
+        /* the first digit of a pair starts a new escaped byte, the case of
+         * the input digits is preserved.
+         */
+        if (em->nibble == 0 && emit_at_line_start(em))
+            emit_line_start(em);
+        if (em->size - em->len < 4)
+            emit_flush(em);
+        /* decimal values are only known once both digits are read */
+        if (em->lang == SYNTAX_DECIMAL) {
+            if (em->nibble == 0) {
+                em->count++;
+                em->digit = hex_value(c);
+            } else {
+                em->len = format_decimal(em->buf + em->len,
+                                         em->digit << 4 | hex_value(c)) -
+                          em->buf;
+            }
+            em->nibble ^= 1;
+            continue;
+        }
+        if (em->nibble == 0) {
+            em->count++;
+            em->buf[em->len++] = '\\';
+            em->buf[em->len++] = 'x';
+        }
+        em->buf[em->len++] = c;
+        em->nibble ^= 1;
+    }
+}
+
+static void emit_close(struct emitter *em, const char *terminator)
+{
+    /* a lone trailing digit is output as it is, like in hex syntaxes */
+    if (em->lang == SYNTAX_DECIMAL && em->nibble != 0) {
+        char value[4];
+
+        emit_write(em, value, format_decimal(value, em->digit) - value);
+    }
+    /* an empty string still gets opened so the output remains valid */
+    if (em->count == 0)
+        emit_line_open(em);
+    emit_string(em, line_close[em->lang]);
+    emit_string(em, terminator);
+}
+
+void emit_end(struct emitter *em)
+{
+    emit_close(em, "\n");
+    emit_flush(em);
+
+    /* get ready for the next binary string */
+    em->count = 0;
+    em->nibble = 0;
+}
+
+void emit_array_end(struct emitter *em)
+{
+    char text[256];
+    int n;
+
+    /* terminate the array declaration, and define its length */
+    switch (em->lang) {
+        case SYNTAX_C:
+            emit_close(em, ";\n");
+            n = snprintf(text, sizeof(text), "unsigned int %s_len = %llu;\n",
+                         em->name, em->count);
+            break;
+        case SYNTAX_DECIMAL:
+            /* initializer lists can't be empty before C23 */
+            emit_close(em, em->count == 0 && em->nibble == 0 ? "0\n};\n"
+                                                             : "\n};\n");
+            n = snprintf(text, sizeof(text), "unsigned int %s_len = %llu;\n",
+                         em->name, em->count);
+            break;
+        default:
+            emit_close(em, "\n");
+            n = snprintf(text, sizeof(text), "%s_len = %llu\n", em->name,
+                         em->count);
+    }
+    emit_write(em, text, (size_t)n < sizeof(text) ? n : sizeof(text) - 1);
+    emit_flush(em);
+
+    em->count = 0;
+    em->nibble = 0;
+}
+
+void emit_sized_declaration(struct emitter *em, unsigned long long size)
+{
+    char text[64];
+    int n;
+
+    /* C runs are filled in by statements, which need the array declared
+     * ahead of them, arrays can't be empty in ISO C.
+     */
+    if (em->lang != SYNTAX_C) {
+        emit_declaration(em);
+        return;
+    }
+    n = snprintf(text, sizeof(text), "unsigned char buffer[%llu];\n",
+                 size > 0 ? size : 1);
+    emit_write(em, text, n);
+}
+
+void emit_segment_begin(struct emitter *em, unsigned long long offset)
+{
+    char text[64];
+    int n;
+
+    /* bytes between two runs are copied to their offset in C */
+    if (em->lang != SYNTAX_C)
+        return;
+    n = snprintf(text, sizeof(text), "memcpy(buffer + 0x%llx,\n", offset);
+    emit_write(em, text, n);
+}
+
+void emit_segment_end(struct emitter *em)
+{
+    char text[64];
+
+    if (em->lang != SYNTAX_C) {
+        emit_end(em);
+        return;
+    }
+    snprintf(text, sizeof(text), ", %llu);\n", em->count);
+    emit_close(em, text);
+    emit_flush(em);
+
+    em->count = 0;
+    em->nibble = 0;
+}
+
+void emit_byte_run(struct emitter *em, unsigned long long offset,
+                   unsigned char byte, unsigned long long len)
+{
+    char text[96];
+    int n;
+
+    /* the current string is closed, the run goes on a line of its own:
+     * a repeated string in Python, a fill statement in C and a GNU range
+     * designator in a decimal list.
+     */
+    if (em->count != 0)
+        emit_segment_end(em);
+    switch (em->lang) {
+        case SYNTAX_C:
+            n = snprintf(text, sizeof(text),
+                         "memset(buffer + 0x%llx, 0x%c%c, %llu);\n", offset,
+                         hex_digits[byte >> 4], hex_digits[byte & 0x0f], len);
+            break;
+        case SYNTAX_DECIMAL:
+            n = snprintf(text, sizeof(text), "[%llu ... %llu] = %u,\n",
+                         offset, offset + len - 1, byte);
+            break;
+        default:
+            n = snprintf(text, sizeof(text),
+                         "buffer += \"\\x%c%c\" * %llu\n",
+                         hex_digits[byte >> 4], hex_digits[byte & 0x0f], len);
+    }
+    emit_write(em, text, n);
+}
+
+void emit_run_marker(struct emitter *em, unsigned long long start,
+                     unsigned long long end, unsigned char byte)
+{
+    char text[64];
+    int n;
+
+    /* a run in the plain hexadecimal view gets a line of its own, marked
+     * with '*' like the repeated lines of hexdump -C, its range of offsets
+     * given as the regions of /proc/PID/maps.
+     */
+    n = snprintf(text, sizeof(text), "* %08llx-%08llx %c%c\n", start, end,
+                 hex_digits[byte >> 4], hex_digits[byte & 0x0f]);
+    emit_write(em, text, n);
+}
+
+size_t emit_escaped_offset(int lang, int width, int declared,
+                           unsigned long long count)
+{
+    /* length of the output preceding byte 'count' of a binary string, as
+     * formatted by emit_declaration() and emit_bytes(). the line break
+     * before the byte, if any, is not part of it.
+     */
+    size_t open, close, len;
+
+    if (lang < SYNTAX_RAW || lang > SYNTAX_PYTHON)
+        lang = SYNTAX_RAW;
+    open = strlen(line_open[lang]);
+    close = strlen(line_close[lang]);
+    len = declared ? strlen(declaration[lang]) : 0;
+
+    if (count == 0)
+        return len;
+    len += open + 4 * count;
+    if (width > 0)
+        len += (count - 1) / width * (close + 1 + open);
+    return len;
+}
+
+size_t emit_escaped_size(int lang, int width, int declared,
+                         unsigned long long count)
+{
+    /* the whole binary string, terminated by emit_end() */
+    if (lang < SYNTAX_RAW || lang > SYNTAX_PYTHON)
+        lang = SYNTAX_RAW;
+    return emit_escaped_offset(lang, width, declared, count) +
+           (count == 0 ? strlen(line_open[lang]) : 0) +
+           strlen(line_close[lang]) + 1;
+}
@@ -0,0 +1,250 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * entropy.c - byte histogram and entropy map
+ *
+ * The input is divided in windows of 'window' bytes starting every 'step'
+ * bytes. Ranges of windows are handed to worker threads, which slide a byte
+ * histogram over their range: only the bytes leaving and entering the window
+ * are counted when moving to the next one.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "include/alloc.h"
+#include "include/entropy.h"
+#include "include/thread.h"
+
+/* bytes counted per pass of the histogram kernel, small enough for its 32-bit
+ * counters never to overflow.
+ */
+#define HISTOGRAM_CHUNK     (1U << 30)
+
+/* bytes sliding in and out of a window below which counters are updated one
+ * by one rather than through the histogram kernel.
+ */
+#define SLIDE_SCALAR_LIMIT  256
+
+/* largest window for which c * log2(c) is tabulated */
+#define XLOGX_TABLE_MAX     (1U << 20)
+
+struct entropy_job {
+    const unsigned char *data;
+    size_t size;
+    size_t window;
+    size_t step;
+    size_t nwindows;
+    struct entropy_window *map;
+    unsigned long long *histogram;  /* whole input histogram, or NULL */
+    double *xlogx;                  /* c * log2(c) for c <= window, or NULL */
+    pthread_mutex_t lock;           /* protects 'histogram' */
+};
+
+static void histogram_kernel(uint32_t sub[4][256], const unsigned char *p,
+                             size_t n)
+{
+    uint64_t v;
+
+    /* incrementing the same counter for consecutive bytes stalls on
+     * store-to-load forwarding, so bytes are spread over four
+     * sub-histograms. eight bytes are loaded at once.
+     */
+    while (n >= 8) {
+        memcpy(&v, p, sizeof(v));
+        sub[0][v & 0xff]++;
+        sub[1][(v >> 8) & 0xff]++;
+        sub[2][(v >> 16) & 0xff]++;
+        sub[3][(v >> 24) & 0xff]++;
+        sub[0][(v >> 32) & 0xff]++;
+        sub[1][(v >> 40) & 0xff]++;
+        sub[2][(v >> 48) & 0xff]++;
+        sub[3][v >> 56]++;
+        p += 8;
+        n -= 8;
+    }
+    while (n-- > 0)
+        sub[0][*p++]++;
+}
+
+void byte_histogram(unsigned long long *histogram, const unsigned char *data,
+                    size_t len)
+{
+    uint32_t sub[4][256];
+    int i;
+
+    /* add the byte counts of 'data' to 'histogram' */
+    while (len > 0) {
+        size_t n = len < HISTOGRAM_CHUNK ? len : HISTOGRAM_CHUNK;
+
+        memset(sub, 0, sizeof(sub));
+        histogram_kernel(sub, data, n);
+        for (i = 0; i < 256; i++)
+            histogram[i] += (unsigned long long)sub[0][i] + sub[1][i] +
+                            sub[2][i] + sub[3][i];
+        data += n;
+        len -= n;
+    }
+}
+
+double histogram_entropy(const unsigned long long *histogram,
+                         unsigned long long total)
+{
+    double sum = 0;
+    int i;
+
+    if (total == 0)
+        return 0;
+
+    /* H = -sum(p * log2(p)) = log2(N) - sum(c * log2(c)) / N */
+    for (i = 0; i < 256; i++) {
+        if (histogram[i] > 1)
+            sum += histogram[i] * log2((double)histogram[i]);
+    }
+    return log2((double)total) - sum / total;
+}
+
+size_t entropy_window_count(size_t size, size_t window, size_t step)
+{
+    /* the last window may be truncated by the end of the input */
+    if (size <= window)
+        return 1;
+    return (size - window + step - 1) / step + 1;
+}
+
+static void window_statistics(const struct entropy_job *job,
+                              struct entropy_window *w,
+                              const unsigned long long *histogram,
+                              unsigned long long total)
+{
+    double sum = 0;
+    int i, top = 0;
+
+    for (i = 1; i < 256; i++) {
+        if (histogram[i] > histogram[top])
+            top = i;
+    }
+    if (job->xlogx != NULL && total > 0) {
+        /* same as histogram_entropy() without a logarithm per counter */
+        for (i = 0; i < 256; i++)
+            sum += job->xlogx[histogram[i]];
+        w->entropy = log2((double)total) - sum / total;
+    } else {
+        w->entropy = histogram_entropy(histogram, total);
+    }
+    w->top = top;
+    w->top_share = total ? (float)histogram[top] / total : 0;
+}
+
+static void entropy_worker(void *ctx, int index, int nthreads)
+{
+    struct entropy_job *job = ctx;
+    unsigned long long histogram[256], leaving[256];
+    size_t first = job->nwindows * index / nthreads;
+    size_t last = job->nwindows * (index + 1) / nthreads;
+    size_t w, start, end, prev_end = 0;
+    int i;
+
+    for (w = first; w < last; w++) {
+        start = w * job->step;
+        end = start + job->window < job->size ? start + job->window
+                                              : job->size;
+
+        if (w == first || job->step >= job->window) {
+            /* first window of the range or disjoint windows: count all */
+            memset(histogram, 0, sizeof(histogram));
+            byte_histogram(histogram, job->data + start, end - start);
+        } else if (job->step < SLIDE_SCALAR_LIMIT) {
+            /* small steps: update the counters of the few bytes sliding */
+            const unsigned char *p;
+
+            for (p = job->data + start - job->step; p < job->data + start;
+                 p++)
+                histogram[*p]--;
+            for (p = job->data + prev_end; p < job->data + end; p++)
+                histogram[*p]++;
+        } else {
+            /* overlapping windows: remove the bytes which slid out and add
+             * the ones which slid in.
+             */
+            memset(leaving, 0, sizeof(leaving));
+            byte_histogram(leaving, job->data + start - job->step,
+                           job->step);
+            for (i = 0; i < 256; i++)
+                histogram[i] -= leaving[i];
+            byte_histogram(histogram, job->data + prev_end, end - prev_end);
+        }
+        window_statistics(job, &job->map[w], histogram, end - start);
+        prev_end = end;
+    }
+
+    /* whole input histogram over a disjoint slice of the input */
+    if (job->histogram != NULL) {
+        start = job->size * index / nthreads;
+        end = job->size * (index + 1) / nthreads;
+        memset(histogram, 0, sizeof(histogram));
+        byte_histogram(histogram, job->data + start, end - start);
+
+        pthread_mutex_lock(&job->lock);
+        for (i = 0; i < 256; i++)
+            job->histogram[i] += histogram[i];
+        pthread_mutex_unlock(&job->lock);
+    }
+}
+
+void compute_entropy_map(const unsigned char *data, size_t size,
+                         size_t window, size_t step, int nthreads,
+                         struct entropy_window *map,
+                         unsigned long long *histogram)
+{
+    struct entropy_job job;
+    size_t i;
+
+    job.data = data;
+    job.size = size;
+    job.window = window;
+    job.step = step;
+    job.nwindows = entropy_window_count(size, window, step);
+    job.map = map;
+    job.histogram = histogram;
+    job.xlogx = NULL;
+    pthread_mutex_init(&job.lock, NULL);
+
+    /* tabulate c * log2(c) when there are many windows of moderate size */
+    if (window <= XLOGX_TABLE_MAX && job.nwindows > 256) {
+        job.xlogx = (double *)allocate_dynamic_memory(sizeof(double) *
+                                                      (window + 1));
+        job.xlogx[0] = 0;
+        for (i = 1; i <= window; i++)
+            job.xlogx[i] = i * log2((double)i);
+    }
+
+    if (histogram != NULL)
+        memset(histogram, 0, 256 * sizeof(*histogram));
+
+    /* no more workers than windows */
+    if ((size_t)nthreads > job.nwindows)
+        nthreads = job.nwindows;
+    run_threads(entropy_worker, &job, nthreads);
+
+    pthread_mutex_destroy(&job.lock);
+    free(job.xlogx);
+}
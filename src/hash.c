@@ -0,0 +1,137 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * hash.c - fast non-cryptographic hash
+ *
+ * An implementation of the 64-bit xxHash algorithm (XXH64), which digests
+ * input in 32-byte stripes over four independent accumulators and runs at
+ * several gigabytes per second. It tells whether inputs changed, it is not
+ * meant to resist forgeries.
+ */
+
+#include <string.h>
+#include "include/hash.h"
+
+#define PRIME64_1   0x9e3779b185ebca87ULL
+#define PRIME64_2   0xc2b2ae3d27d4eb4fULL
+#define PRIME64_3   0x165667b19e3779f9ULL
+#define PRIME64_4   0x85ebca77c2b2ae63ULL
+#define PRIME64_5   0x27d4eb2f165667c5ULL
+
+static unsigned long long rotl64(unsigned long long x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static unsigned long long read64(const unsigned char *p)
+{
+    unsigned long long v;
+
+    /* xxHash reads words in little-endian order */
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static unsigned long long read32(const unsigned char *p)
+{
+    unsigned int v;
+
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static unsigned long long hash_round(unsigned long long acc,
+                                     unsigned long long input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static unsigned long long hash_merge(unsigned long long acc,
+                                     unsigned long long v)
+{
+    acc ^= hash_round(0, v);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+unsigned long long hash64(const void *data, size_t len,
+                          unsigned long long seed)
+{
+    const unsigned char *p = data;
+    const unsigned char *end = p + len;
+    unsigned long long h;
+
+    if (len >= 32) {
+        unsigned long long v1 = seed + PRIME64_1 + PRIME64_2;
+        unsigned long long v2 = seed + PRIME64_2;
+        unsigned long long v3 = seed;
+        unsigned long long v4 = seed - PRIME64_1;
+
+        /* four independent lanes keep the multipliers busy */
+        do {
+            v1 = hash_round(v1, read64(p));
+            v2 = hash_round(v2, read64(p + 8));
+            v3 = hash_round(v3, read64(p + 16));
+            v4 = hash_round(v4, read64(p + 24));
+            p += 32;
+        } while (p + 32 <= end);
+
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = hash_merge(h, v1);
+        h = hash_merge(h, v2);
+        h = hash_merge(h, v3);
+        h = hash_merge(h, v4);
+    } else {
+        h = seed + PRIME64_5;
+    }
+
+    h += len;
+
+    /* tail of the input */
+    while (p + 8 <= end) {
+        h ^= hash_round(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= *p * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+        p++;
+    }
+
+    /* final avalanche */
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
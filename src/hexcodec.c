@@ -0,0 +1,530 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * hexcodec.c - parallel hexadecimal encoder and decoder
+ *
+ * The input is processed in rounds of up to one chunk per worker thread.
+ * The output of a chunk only depends on the number of hexadecimal digits
+ * (or bytes) preceding it, which decides where lines break and whether the
+ * chunk starts in the middle of a byte. Hexadecimal digits are therefore
+ * counted first, in parallel and with SSE2 when available, then every chunk
+ * is formatted by its own emitter in a private buffer. Buffers are finally
+ * handed over in order to the caller's emitter output.
+ *
+ * Bytes can also be formatted straight into an output of known size, such as
+ * a mapped file: the position of every byte in the output is computed up
+ * front, so workers write their chunks in place with no ordering at all.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/alloc.h"
+#include "include/emit.h"
+#include "include/hexcodec.h"
+#include "include/thread.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define CODEC_MIN_CHUNK     (64 << 10)  /* smallest chunk worth a thread */
+
+/* kinds of conversions */
+#define CODEC_ESCAPE_TEXT   0       /* hex text to escaped binary string */
+#define CODEC_DECODE_TEXT   1       /* hex text to raw bytes */
+#define CODEC_ESCAPE_BYTES  2       /* bytes to escaped binary string */
+
+/* growable memory buffer receiving the output of a chunk */
+struct membuf {
+    char *data;
+    size_t len;
+    size_t size;
+    struct arena *arena;        /* holds 'data' */
+};
+
+struct chunk {
+    const char *input;
+    size_t len;
+    unsigned long long digits;      /* hex digits in the chunk */
+    unsigned long invalid;          /* invalid characters in the chunk */
+    int last_digit;                 /* value of the last hex digit */
+    unsigned long long before;      /* digits (or bytes) before the chunk */
+    int carry;                      /* pending high nibble, -1 if none */
+    struct membuf out;
+};
+
+struct codec_job {
+    const struct emitter *em;
+    int kind;
+    int nchunks;                    /* chunks of the current round */
+    struct chunk chunks[MAX_THREADS];
+};
+
+/* arenas of the chunks outputs, reset rather than freed after each
+ * conversion so a batch of inputs doesn't allocate them again every time.
+ * a zeroed arena is empty, its blocks sized after the first allocation.
+ */
+static struct arena chunk_arenas[MAX_THREADS];
+
+static void membuf_append(void *ctx, const char *data, size_t len)
+{
+    struct membuf *mb = ctx;
+
+    if (mb->len + len > mb->size) {
+        mb->data = arena_grow(mb->arena, mb->data, mb->len,
+                              (mb->len + len) * 2);
+        mb->size = (mb->len + len) * 2;
+    }
+    memcpy(mb->data + mb->len, data, len);
+    mb->len += len;
+}
+
+/* region of a preallocated output written by a worker */
+struct region {
+    char *data;
+    size_t left;
+};
+
+/* job of workers formatting bytes in place */
+struct place_job {
+    char *out;
+    const unsigned char *data;
+    size_t len;
+    size_t start;                   /* range of bytes to format */
+    size_t end;
+    size_t chunk_size;
+    int lang;
+    int width;
+    int flags;
+};
+
+static void region_append(void *ctx, const char *data, size_t len)
+{
+    struct region *r = ctx;
+
+    /* the output size was computed for this exact content */
+    if (len > r->left) {
+        printf("Error: encoded output exceeds its computed size.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(r->data, data, len);
+    r->data += len;
+    r->left -= len;
+}
+
+static int hex_value(unsigned char c)
+{
+    return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+#ifdef __SSE2__
+static int hex_digits_mask(__m128i v, int *skipped)
+{
+    /* bitmask of the hex digits among 16 characters, signed compares keep
+     * bytes above 0x7f out of the ranges.
+     */
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i alpha = _mm_and_si128(
+                        _mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                        _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+
+    if (skipped != NULL) {
+        __m128i skip = _mm_or_si128(
+                           _mm_or_si128(_mm_cmpeq_epi8(v, _mm_setzero_si128()),
+                                        _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+                           _mm_cmpeq_epi8(v, _mm_set1_epi8((char)0xff)));
+        *skipped = _mm_movemask_epi8(skip);
+    }
+    return _mm_movemask_epi8(_mm_or_si128(digit, alpha));
+}
+
+static void decode_16_digits(const char *p, unsigned char *out)
+{
+    /* 16 hex digits to 8 bytes: digit values in 16-bit lanes are combined
+     * as (even << 4 | odd) then packed back to bytes.
+     */
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i is_alpha = _mm_cmpgt_epi8(v, _mm_set1_epi8('9'));
+    __m128i dval = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    __m128i aval = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)),
+                                _mm_set1_epi8('a' - 10));
+    __m128i val = _mm_or_si128(_mm_and_si128(is_alpha, aval),
+                               _mm_andnot_si128(is_alpha, dval));
+    __m128i hi = _mm_slli_epi16(_mm_and_si128(val, _mm_set1_epi16(0x00ff)),
+                                4);
+    __m128i bytes = _mm_or_si128(hi, _mm_srli_epi16(val, 8));
+
+    _mm_storel_epi64((__m128i *)out, _mm_packus_epi16(bytes, bytes));
+}
+#endif
+
+static void count_chunk(struct chunk *c)
+{
+    const unsigned char *p = (const unsigned char *)c->input;
+    size_t i = 0;
+    int k;
+
+    c->digits = 0;
+    c->invalid = 0;
+    c->last_digit = -1;
+
+#ifdef __SSE2__
+    for (; i + 16 <= c->len; i += 16) {
+        int skipped, hex = hex_digits_mask(
+                               _mm_loadu_si128((const __m128i *)(p + i)),
+                               &skipped);
+
+        c->digits += __builtin_popcount(hex);
+        c->invalid += 16 - __builtin_popcount(hex | skipped);
+    }
+#endif
+    for (; i < c->len; i++) {
+        if (hex_class[p[i]] == HEX_DIGIT)
+            c->digits++;
+        else if (hex_class[p[i]] == HEX_INVALID)
+            c->invalid++;
+    }
+
+    /* the last digit may pair with the first one of the next chunk */
+    for (k = (int)c->len - 1; k >= 0 && c->digits > 0; k--) {
+        if (hex_class[p[k]] == HEX_DIGIT) {
+            c->last_digit = hex_value(p[k]);
+            break;
+        }
+    }
+}
+
+static void count_worker(void *ctx, int index, int nthreads)
+{
+    struct codec_job *job = ctx;
+    int i;
+
+    /* chunks are taken in turn, should there be fewer workers */
+    for (i = index; i < job->nchunks; i += nthreads)
+        count_chunk(&job->chunks[i]);
+}
+
+static void decode_chunk(struct chunk *c)
+{
+    const unsigned char *p = (const unsigned char *)c->input;
+    unsigned char *out;
+    size_t i = 0, n = 0;
+    int carry = c->carry;
+
+    if (c->out.size < c->len / 2 + 1) {
+        c->out.size = c->len / 2 + 1;
+        c->out.data = arena_grow(c->out.arena, c->out.data, 0,
+                                 c->out.size);
+    }
+    out = (unsigned char *)c->out.data;
+
+    while (i < c->len) {
+#ifdef __SSE2__
+        /* runs of 16 hex digits at a byte boundary are decoded at once */
+        while (carry < 0 && i + 16 <= c->len &&
+               hex_digits_mask(_mm_loadu_si128((const __m128i *)(p + i)),
+                               NULL) == 0xffff) {
+            decode_16_digits((const char *)p + i, out + n);
+            i += 16;
+            n += 8;
+        }
+        if (i >= c->len)
+            break;
+#endif
+        if (hex_class[p[i]] == HEX_DIGIT) {
+            if (carry < 0) {
+                carry = hex_value(p[i]);
+            } else {
+                out[n++] = carry << 4 | hex_value(p[i]);
+                carry = -1;
+            }
+        }
+        i++;
+    }
+
+    /* a trailing lone digit is output by the next chunk */
+    c->out.len = n;
+}
+
+static void format_chunk(const struct codec_job *job, struct chunk *c)
+{
+    struct emitter em;
+
+    c->out.len = 0;
+    if (job->kind == CODEC_DECODE_TEXT) {
+        decode_chunk(c);
+        return;
+    }
+
+    /* an emitter picking up where the previous chunks left the string */
+    emit_init(&em, job->em->lang, job->em->width);
+    em.flush = membuf_append;
+    em.ctx = &c->out;
+    em.name = job->em->name;
+    if (job->kind == CODEC_ESCAPE_BYTES) {
+        em.count = c->before;
+        emit_bytes(&em, (const unsigned char *)c->input, c->len);
+    } else {
+        em.count = (c->before + 1) / 2;
+        em.nibble = c->before & 1;
+        em.digit = c->carry < 0 ? 0 : c->carry;
+        emit_hex_text(&em, c->input, c->len);
+    }
+    emit_free(&em);
+}
+
+static void format_worker(void *ctx, int index, int nthreads)
+{
+    struct codec_job *job = ctx;
+    int i;
+
+    for (i = index; i < job->nchunks; i += nthreads)
+        format_chunk(job, &job->chunks[i]);
+}
+
+static size_t output_ratio(const struct emitter *em, int kind)
+{
+    size_t bytes;
+
+    /* output bytes per input byte a round holds, rounded up: two digits
+     * make a byte, formatted or not.
+     */
+    if (kind == CODEC_DECODE_TEXT)
+        return 1;
+    bytes = emit_escaped_size(em->lang, em->width, 0, CODEC_MIN_CHUNK) /
+            CODEC_MIN_CHUNK + 1;
+    return kind == CODEC_ESCAPE_BYTES ? bytes : bytes / 2 + 1;
+}
+
+static void run_codec(struct emitter *em, int kind, const char *input,
+                      size_t len, int nthreads)
+{
+    size_t ratio = output_ratio(em, kind), budget;
+    struct codec_job job;
+    unsigned long long before;
+    size_t pos = 0, chunk_size;
+    int i, n, pending = -1;
+
+    memset(&job, 0, sizeof(job));
+    job.em = em;
+    job.kind = kind;
+    for (i = 0; i < MAX_THREADS; i++)
+        job.chunks[i].out.arena = &chunk_arenas[i];
+
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+    /* the outputs of a round stay within the memory budget, with fewer
+     * workers if chunks would get too small.
+     */
+    budget = memory_budget((size_t)nthreads * CODEC_CHUNK_SIZE * ratio);
+    if (budget / ((size_t)nthreads * ratio) < CODEC_MIN_CHUNK) {
+        nthreads = budget / (CODEC_MIN_CHUNK * ratio);
+        if (nthreads < 1)
+            nthreads = 1;
+    }
+
+    /* spread small inputs over all workers too */
+    chunk_size = (len + nthreads - 1) / nthreads;
+    if (chunk_size > CODEC_CHUNK_SIZE)
+        chunk_size = CODEC_CHUNK_SIZE;
+    if (chunk_size > budget / ((size_t)nthreads * ratio))
+        chunk_size = budget / ((size_t)nthreads * ratio);
+    if (chunk_size < CODEC_MIN_CHUNK)
+        chunk_size = CODEC_MIN_CHUNK;
+
+    /* digits (or bytes) already output by the caller's emitter */
+    before = kind == CODEC_ESCAPE_BYTES ? em->count
+                                        : 2 * em->count - em->nibble;
+    /* a lone digit left by the previous call starts the first byte */
+    if (kind != CODEC_ESCAPE_BYTES && em->nibble != 0)
+        pending = em->digit;
+
+    while (pos < len) {
+        for (n = 0; n < nthreads && pos < len; n++) {
+            job.chunks[n].input = input + pos;
+            job.chunks[n].len = len - pos < chunk_size ? len - pos
+                                                       : chunk_size;
+            pos += job.chunks[n].len;
+        }
+        job.nchunks = n;
+
+        /* first pass: count the digits of each chunk */
+        if (kind != CODEC_ESCAPE_BYTES)
+            run_threads(count_worker, &job, n);
+
+        /* starting state of every chunk */
+        for (i = 0; i < n; i++) {
+            struct chunk *c = &job.chunks[i];
+
+            c->before = before;
+            c->carry = pending;
+            if (kind == CODEC_ESCAPE_BYTES) {
+                before += c->len;
+                continue;
+            }
+            before += c->digits;
+            em->invalid += c->invalid;
+            if (c->digits > 0)
+                pending = before & 1 ? c->last_digit : -1;
+        }
+
+        /* second pass: format the chunks, then output them in order */
+        run_threads(format_worker, &job, n);
+        emit_flush(em);
+        for (i = 0; i < n; i++) {
+            if (job.chunks[i].out.len > 0)
+                em->flush(em->ctx, job.chunks[i].out.data,
+                          job.chunks[i].out.len);
+        }
+    }
+
+    /* the caller's emitter continues after the converted input */
+    if (kind == CODEC_ESCAPE_BYTES) {
+        em->count = before;
+    } else {
+        em->count = (before + 1) / 2;
+        em->nibble = before & 1;
+        em->digit = pending < 0 ? 0 : pending;
+    }
+
+    for (i = 0; i < MAX_THREADS; i++)
+        arena_reset(&chunk_arenas[i]);
+}
+
+void encode_hex_text(struct emitter *em, const char *text, size_t len,
+                     int nthreads)
+{
+    run_codec(em, CODEC_ESCAPE_TEXT, text, len, nthreads);
+}
+
+void decode_hex_text(struct emitter *em, const char *text, size_t len,
+                     int nthreads)
+{
+    run_codec(em, CODEC_DECODE_TEXT, text, len, nthreads);
+}
+
+void encode_bytes(struct emitter *em, const unsigned char *data, size_t len,
+                  int nthreads)
+{
+    run_codec(em, CODEC_ESCAPE_BYTES, (const char *)data, len, nthreads);
+}
+
+size_t encoded_size(int lang, int width, int flags, size_t len)
+{
+    if (flags & ENCODE_PLAIN_HEX)
+        return 2 * len;
+    return emit_escaped_size(lang, width, flags & ENCODE_DECLARATION, len);
+}
+
+static size_t place_offset(const struct place_job *job, size_t pos)
+{
+    /* the first chunk outputs the declaration too */
+    if (pos == 0)
+        return 0;
+    if (job->flags & ENCODE_PLAIN_HEX)
+        return 2 * pos;
+    return emit_escaped_offset(job->lang, job->width,
+                               job->flags & ENCODE_DECLARATION, pos);
+}
+
+static void place_worker(void *ctx, int index, int nthreads)
+{
+    struct place_job *job = ctx;
+    struct emitter em;
+    struct region r;
+    size_t pos, end, total;
+
+    total = encoded_size(job->lang, job->width, job->flags, job->len);
+
+    /* chunks are taken in turn, an empty input is a single empty chunk */
+    for (pos = job->start + (size_t)index * job->chunk_size;
+         pos < job->end || (pos == 0 && index == 0);
+         pos += (size_t)nthreads * job->chunk_size) {
+        end = job->end - pos < job->chunk_size ? job->end
+                                               : pos + job->chunk_size;
+
+        emit_init(&em, job->flags & ENCODE_PLAIN_HEX ? SYNTAX_RAW
+                                                     : job->lang,
+                  job->width);
+        r.data = job->out + place_offset(job, pos);
+        r.left = (end == job->len ? total : place_offset(job, end)) -
+                 place_offset(job, pos);
+        em.flush = region_append;
+        em.ctx = &r;
+        em.count = pos;
+
+        if (job->flags & ENCODE_PLAIN_HEX) {
+            emit_hex_digits(&em, job->data + pos, end - pos);
+        } else {
+            if (pos == 0 && (job->flags & ENCODE_DECLARATION))
+                emit_declaration(&em);
+            emit_bytes(&em, job->data + pos, end - pos);
+            if (end == job->len)
+                emit_end(&em);
+        }
+        emit_free(&em);
+
+        if (end == job->end)
+            break;
+    }
+}
+
+void encode_bytes_in_place(char *out, int lang, int width, int flags,
+                           const unsigned char *data, size_t len,
+                           size_t start, size_t end, int nthreads)
+{
+    struct place_job job;
+
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+
+    job.out = out;
+    job.data = data;
+    job.len = len;
+    job.lang = lang;
+    job.width = width > 0 ? width : 0;
+    job.flags = flags;
+
+    /* chunks start on a line so their line breaks don't depend on the
+     * previous chunks, the range is widened to whole lines.
+     */
+    if (job.width > 0) {
+        start -= start % job.width;
+        if (end % job.width != 0)
+            end += job.width - end % job.width;
+    }
+    job.start = start;
+    job.end = end < len ? end : len;
+    job.chunk_size = (job.end - job.start + nthreads - 1) / nthreads;
+    if (job.chunk_size > CODEC_CHUNK_SIZE)
+        job.chunk_size = CODEC_CHUNK_SIZE;
+    if (job.chunk_size < CODEC_MIN_CHUNK)
+        job.chunk_size = CODEC_MIN_CHUNK;
+    if (job.width > 0)
+        job.chunk_size += job.width - 1 - (job.chunk_size - 1) % job.width;
+
+    run_threads(place_worker, &job, nthreads);
+}
@@ -0,0 +1,122 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * incbin.c - assembler .incbin sources
+ *
+ * Large binary strings are slow for compilers to parse, the assembler
+ * includes a raw binary file as it is instead. An assembler source defines
+ * a symbol holding the bytes of the file with .incbin, and a C header
+ * declares it with its size, which is known when they are generated.
+ *
+ * The type and section directives use the '%' prefix, that ELF assemblers
+ * accept on every target, unlike '@' which starts comments on ARM.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "include/incbin.h"
+
+static FILE * create_source(const char *base, const char *suffix)
+{
+    char filename[1024];
+    FILE *fp;
+
+    snprintf(filename, sizeof(filename), "%s%s", base, suffix);
+    fp = fopen(filename, "w");
+    if (fp == NULL) {
+        printf("Error: output filename \"%s\" cannot be written.\n",
+               filename);
+        exit(EXIT_FAILURE);
+    }
+    return fp;
+}
+
+static void close_source(FILE *fp, const char *base, const char *suffix)
+{
+    if (fclose(fp) != 0) {
+        printf("Error: output filename \"%s%s\" cannot be written.\n", base,
+               suffix);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void incbin_symbol(const char *base, char *symbol, size_t len)
+{
+    const char *name = strrchr(base, '/');
+    size_t i = 0;
+
+    /* the file name of 'base', with anything but letters, digits and
+     * underscores replaced, is a valid C and assembler identifier.
+     */
+    name = name != NULL ? name + 1 : base;
+    if (isdigit((unsigned char)*name) || *name == '\0')
+        symbol[i++] = '_';
+    for (; *name != '\0' && i + 1 < len; name++)
+        symbol[i++] = isalnum((unsigned char)*name) ? *name : '_';
+    symbol[i] = '\0';
+}
+
+void write_incbin_sources(const char *base, const char *binary_filename,
+                          unsigned long long size)
+{
+    char symbol[INCBIN_SYMBOL_LENGTH], guard[INCBIN_SYMBOL_LENGTH];
+    const char *p;
+    FILE *fp;
+    int i;
+
+    incbin_symbol(base, symbol, sizeof(symbol));
+    for (i = 0; symbol[i] != '\0'; i++)
+        guard[i] = toupper((unsigned char)symbol[i]);
+    guard[i] = '\0';
+
+    /* the binary is named without its directory, the assembler looks it up
+     * from the current directory, then from its include path (-I).
+     */
+    p = strrchr(binary_filename, '/');
+    binary_filename = p != NULL ? p + 1 : binary_filename;
+
+    fp = create_source(base, ".S");
+    fprintf(fp, "/* generated by bstrings, %llu byte(s) */\n", size);
+    fprintf(fp, "\t.section .rodata\n");
+    fprintf(fp, "\t.global %s\n", symbol);
+    fprintf(fp, "\t.type %s, %%object\n", symbol);
+    fprintf(fp, "\t.balign 16\n");
+    fprintf(fp, "%s:\n", symbol);
+    fprintf(fp, "\t.incbin \"");
+    for (p = binary_filename; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\')
+            fputc('\\', fp);
+        fputc(*p, fp);
+    }
+    fprintf(fp, "\"\n");
+    fprintf(fp, "\t.size %s, %llu\n", symbol, size);
+    fprintf(fp, "\t.section .note.GNU-stack,\"\",%%progbits\n");
+    close_source(fp, base, ".S");
+
+    fp = create_source(base, ".h");
+    fprintf(fp, "/* generated by bstrings, %llu byte(s) */\n\n", size);
+    fprintf(fp, "#ifndef %s_H\n#define %s_H\n\n", guard, guard);
+    fprintf(fp, "#define %s_size %lluUL\n", symbol, size);
+    fprintf(fp, "extern const unsigned char %s[%s_size];\n\n", symbol,
+            symbol);
+    fprintf(fp, "#endif /* #ifndef %s_H */\n", guard);
+    close_source(fp, base, ".h");
+}
@@ -0,0 +1,47 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * alloc.h - dynamic memory allocation header file
+ */
+
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+
+char * allocate_dynamic_memory(size_t alloc_size);
+char * change_dynamic_memory(char *ptr, size_t new_size);
+
+#define ARENA_BLOCK_SIZE    (1 << 20)   /* default arena block size */
+#define MEMORY_POOLS        4           /* buffer pools sharing the limit */
+#define MEMORY_LIMIT_MIN    (16 << 20)  /* smallest memory limit */
+
+struct arena_block {
+    struct arena_block *next;   /* block filled before this one */
+    size_t size;                /* block size, header included */
+    size_t used;                /* bytes allocated, header included */
+};
+
+/* bump allocator, reset after each job */
+struct arena {
+    struct arena_block *block;  /* current block, NULL until first used */
+    size_t block_size;          /* minimum room of new blocks */
+    void *last;                 /* last allocation, which can grow in place */
+};
+
+void set_huge_pages(int enabled);
+void set_memory_limit(size_t limit);
+size_t memory_budget(size_t wanted);
+int memory_exceeded(size_t size);
+void arena_init(struct arena *a, size_t block_size);
+void * arena_alloc(struct arena *a, size_t size);
+void * arena_grow(struct arena *a, void *ptr, size_t old_size,
+                  size_t new_size);
+void arena_reset(struct arena *a);
+void arena_release(struct arena *a);
+
+#endif /* #ifndef ALLOC_H */
@@ -0,0 +1,42 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * cache.h - content-addressed output cache header file
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include "emit.h"
+
+#define CACHE_DEFAULT_SIZE  (256ULL << 20)  /* cache size limit in bytes */
+
+struct cache {
+    char *dir;                  /* cache directory, NULL if disabled */
+    unsigned long long max_size; /* total size of the entries allowed */
+    char path[4096];            /* path of the current entry */
+    char tmp[4096];             /* path of the entry being written */
+    int fd;                     /* entry being read or written, -1 if none */
+    struct emitter *em;         /* emitter whose output is recorded */
+    emit_flush_fn flush;        /* its output callback */
+    void *ctx;                  /* and the callback context */
+    unsigned long hits;         /* lookups served from the cache */
+    unsigned long misses;       /* lookups that were not */
+    unsigned long invalid;      /* invalid characters of a hit's input */
+    int nibble;                 /* its input ended with a lone digit */
+};
+
+void cache_open(struct cache *c, const char *dir,
+                unsigned long long max_size);
+int cache_lookup(struct cache *c, unsigned long long key);
+void cache_send(struct cache *c, FILE *stream);
+void cache_record(struct cache *c, struct emitter *em);
+void cache_commit(struct cache *c);
+void cache_close(struct cache *c);
+
+#endif /* #ifndef CACHE_H */
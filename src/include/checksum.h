@@ -0,0 +1,42 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * checksum.h - CRC32, CRC32C and SHA-256 checksums header file
+ */
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stddef.h>
+
+/* checksums selected with --checksum */
+#define CHECKSUM_CRC32      0x01
+#define CHECKSUM_CRC32C     0x02
+#define CHECKSUM_SHA256     0x04
+
+#define CHECKSUM_TEXT_SIZE  65      /* longest formatted checksum */
+
+/* running checksums of a stream of bytes */
+struct checksums {
+    int kinds;                  /* CHECKSUM_* flags */
+    unsigned int crc32;
+    unsigned int crc32c;
+    unsigned int sha256[8];     /* SHA-256 state, then digest */
+    unsigned char block[64];    /* pending SHA-256 block */
+    size_t block_len;
+    unsigned long long length;  /* bytes digested */
+};
+
+int parse_checksum_kinds(const char *list);
+const char * checksum_name(int kind);
+void checksums_init(struct checksums *cs, int kinds);
+void checksums_update(struct checksums *cs, const unsigned char *data,
+                      size_t len);
+void checksums_final(struct checksums *cs);
+void checksum_format(const struct checksums *cs, int kind, char *text);
+
+#endif /* #ifndef CHECKSUM_H */
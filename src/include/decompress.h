@@ -0,0 +1,31 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * decompress.h - streaming input decompression header file
+ */
+
+#ifndef DECOMPRESS_H
+#define DECOMPRESS_H
+
+#include <stddef.h>
+
+#define DECOMPRESS_BUFFER_SIZE  (256 << 10) /* decompressor buffers size */
+#define DECOMPRESS_PIPE_SIZE    (1 << 20)   /* pipe capacity asked for */
+
+/* compressed input formats */
+#define COMPRESSION_NONE    0
+#define COMPRESSION_GZIP    1
+#define COMPRESSION_XZ      2
+#define COMPRESSION_ZSTD    3
+
+void set_decompression(int enabled);
+int detect_compression(const unsigned char *data, size_t len);
+const char *compression_name(int format);
+int decompress_fd(const char *filename, int fd);
+int decompress_finish(int fd, char *error, size_t size);
+
+#endif /* #ifndef DECOMPRESS_H */
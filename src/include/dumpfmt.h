@@ -0,0 +1,54 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * dumpfmt.h - textual dump formats parser header file
+ */
+
+#ifndef DUMPFMT_H
+#define DUMPFMT_H
+
+#include <stddef.h>
+
+/* hexadecimal input formats */
+#define DUMP_AUTO           -1      /* detect from the input */
+#define DUMP_PLAIN          0       /* bare hexadecimal digits */
+#define DUMP_XXD            1       /* xxd */
+#define DUMP_HEXDUMP        2       /* hexdump -C */
+#define DUMP_OBJDUMP        3       /* objdump -d */
+#define DUMP_GDB            4       /* gdb x/x examine command */
+
+#define DUMP_BUFFER_SIZE    4096    /* bytes buffered before the callback */
+
+/* callback receiving the bytes extracted from each line */
+typedef void (*dump_bytes_fn)(void *ctx, const unsigned char *data,
+                              size_t len);
+
+/* dump parser state, carried from one call of dump_parser_feed() to the next */
+struct dump_parser {
+    int format;                 /* one of DUMP_* */
+    unsigned char buf[DUMP_BUFFER_SIZE];
+    size_t len;
+    dump_bytes_fn fn;
+    void *ctx;
+    /* hexdump -C squeezed lines ('*') state */
+    unsigned char prev[DUMP_BUFFER_SIZE];
+    size_t prev_len;
+    unsigned long long next_offset;
+    int squeezed;
+};
+
+int dump_format_from_name(const char *name);
+const char * dump_format_name(int format);
+int detect_dump_format(const char *text, size_t len);
+int detect_dump_format_prefix(const char *text, size_t len);
+void dump_parser_init(struct dump_parser *dp, int format, dump_bytes_fn fn,
+                      void *ctx);
+void dump_parser_feed(struct dump_parser *dp, const char *text, size_t len);
+void parse_dump(int format, const char *text, size_t len, dump_bytes_fn fn,
+                void *ctx);
+
+#endif /* #ifndef DUMPFMT_H */
@@ -0,0 +1,33 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * elfparse.h - ELF sections and symbols lookup header file
+ */
+
+#ifndef ELFPARSE_H
+#define ELFPARSE_H
+
+#include <stddef.h>
+
+/* lookup errors */
+#define ELF_ERR_FORMAT      -1      /* not an ELF file or malformed */
+#define ELF_ERR_NOTFOUND    -2      /* no such section or symbol */
+#define ELF_ERR_NOBITS      -3      /* no content in the file (e.g. .bss) */
+
+/* range of bytes of the file holding a section or a symbol */
+struct elf_range {
+    unsigned long long offset;
+    unsigned long long size;
+};
+
+int elf_find_section(const unsigned char *data, size_t size,
+                     const char *name, struct elf_range *range);
+int elf_find_symbol(const unsigned char *data, size_t size,
+                    const char *name, struct elf_range *range);
+const char * elf_strerror(int error);
+
+#endif /* #ifndef ELFPARSE_H */
@@ -0,0 +1,75 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * emit.h - binary string syntax emitters header file
+ */
+
+#ifndef EMIT_H
+#define EMIT_H
+
+#include <stddef.h>
+
+/* binary string output syntaxes selected with -s|--syntax */
+#define SYNTAX_RAW          0
+#define SYNTAX_C            1
+#define SYNTAX_PYTHON       2
+#define SYNTAX_DECIMAL      3       /* comma separated decimal list */
+
+#define EMIT_BUFFER_SIZE    65536   /* emitter output buffer size in bytes */
+
+/* classes of characters in hexadecimal text input */
+#define HEX_INVALID         0       /* counted as invalid */
+#define HEX_DIGIT           1       /* hexadecimal digit */
+#define HEX_SKIPPED         2       /* silently skipped */
+
+extern const unsigned char hex_class[256];
+
+/* output callback receiving formatted binary string chunks */
+typedef void (*emit_flush_fn)(void *ctx, const char *data, size_t len);
+
+struct emitter {
+    int lang;                   /* output syntax, one of SYNTAX_* */
+    int width;                  /* bytes per line, zero for no limit */
+    unsigned long long count;   /* bytes emitted in the current string */
+    int nibble;                 /* a lone hex digit is pending (text mode) */
+    int digit;                  /* value of the pending digit (decoding) */
+    unsigned long invalid;      /* non-hexadecimal characters seen */
+    char *buf;                  /* formatted output buffer */
+    size_t len;                 /* bytes pending in 'buf' */
+    size_t size;                /* capacity of 'buf' */
+    emit_flush_fn flush;        /* output callback */
+    void *ctx;                  /* output callback context */
+    const char *name;           /* array name, NULL for "buffer" */
+};
+
+void emit_init(struct emitter *em, int lang, int width);
+void emit_free(struct emitter *em);
+void emit_flush(struct emitter *em);
+void emit_flush_stream(void *ctx, const char *data, size_t len);
+void emit_write(struct emitter *em, const char *data, size_t len);
+void emit_declaration(struct emitter *em);
+void emit_comment(struct emitter *em, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+void emit_bytes(struct emitter *em, const unsigned char *data, size_t len);
+void emit_hex_digits(struct emitter *em, const unsigned char *data,
+                     size_t len);
+void emit_hex_text(struct emitter *em, const char *text, size_t len);
+void emit_end(struct emitter *em);
+void emit_array_end(struct emitter *em);
+void emit_sized_declaration(struct emitter *em, unsigned long long size);
+void emit_segment_begin(struct emitter *em, unsigned long long offset);
+void emit_segment_end(struct emitter *em);
+void emit_byte_run(struct emitter *em, unsigned long long offset,
+                   unsigned char byte, unsigned long long len);
+void emit_run_marker(struct emitter *em, unsigned long long start,
+                     unsigned long long end, unsigned char byte);
+size_t emit_escaped_offset(int lang, int width, int declared,
+                           unsigned long long count);
+size_t emit_escaped_size(int lang, int width, int declared,
+                         unsigned long long count);
+
+#endif /* #ifndef EMIT_H */
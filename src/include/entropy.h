@@ -0,0 +1,35 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * entropy.h - byte histogram and entropy map header file
+ */
+
+#ifndef ENTROPY_H
+#define ENTROPY_H
+
+#include <stddef.h>
+
+#define ENTROPY_WINDOW_SIZE 4096    /* default window size in bytes */
+
+/* statistics of a single window */
+struct entropy_window {
+    float entropy;              /* Shannon entropy in bits per byte */
+    float top_share;            /* share of the most frequent byte */
+    unsigned char top;          /* most frequent byte value */
+};
+
+size_t entropy_window_count(size_t size, size_t window, size_t step);
+void compute_entropy_map(const unsigned char *data, size_t size,
+                         size_t window, size_t step, int nthreads,
+                         struct entropy_window *map,
+                         unsigned long long *histogram);
+void byte_histogram(unsigned long long *histogram, const unsigned char *data,
+                    size_t len);
+double histogram_entropy(const unsigned long long *histogram,
+                         unsigned long long total);
+
+#endif /* #ifndef ENTROPY_H */
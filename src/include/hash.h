@@ -0,0 +1,19 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * hash.h - fast non-cryptographic hash header file
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+
+unsigned long long hash64(const void *data, size_t len,
+                          unsigned long long seed);
+
+#endif /* #ifndef HASH_H */
@@ -0,0 +1,34 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * hexcodec.h - parallel hexadecimal encoder and decoder header file
+ */
+
+#ifndef HEXCODEC_H
+#define HEXCODEC_H
+
+#include <stddef.h>
+#include "emit.h"
+
+#define CODEC_CHUNK_SIZE    (8 << 20)   /* input bytes per worker and round */
+
+/* encode_bytes_in_place() flags */
+#define ENCODE_DECLARATION  1           /* precede with a declaration */
+#define ENCODE_PLAIN_HEX    2           /* plain hex digits, not escaped */
+
+void encode_hex_text(struct emitter *em, const char *text, size_t len,
+                     int nthreads);
+void decode_hex_text(struct emitter *em, const char *text, size_t len,
+                     int nthreads);
+void encode_bytes(struct emitter *em, const unsigned char *data, size_t len,
+                  int nthreads);
+size_t encoded_size(int lang, int width, int flags, size_t len);
+void encode_bytes_in_place(char *out, int lang, int width, int flags,
+                           const unsigned char *data, size_t len,
+                           size_t start, size_t end, int nthreads);
+
+#endif /* #ifndef HEXCODEC_H */
@@ -0,0 +1,22 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * incbin.h - assembler .incbin sources header file
+ */
+
+#ifndef INCBIN_H
+#define INCBIN_H
+
+#include <stddef.h>
+
+#define INCBIN_SYMBOL_LENGTH 128    /* max length of the generated symbol */
+
+void incbin_symbol(const char *base, char *symbol, size_t len);
+void write_incbin_sources(const char *base, const char *binary_filename,
+                          unsigned long long size);
+
+#endif /* #ifndef INCBIN_H */
@@ -0,0 +1,30 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * input.h - memory-mapped input header file
+ */
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stddef.h>
+#include "alloc.h"
+
+struct input_map {
+    unsigned char *data;        /* input content */
+    size_t size;                /* input length in bytes */
+    int mapped;                 /* 'data' is a file mapping */
+    int fd;                     /* the mapped file, -1 if not mapped */
+    struct arena arena;         /* holds 'data' when it isn't */
+};
+
+void map_input(const char *filename, struct input_map *map);
+void unmap_input(struct input_map *map);
+void input_next_hole(const struct input_map *map, size_t pos,
+                     size_t *hole_start, size_t *hole_end);
+
+#endif /* #ifndef INPUT_H */
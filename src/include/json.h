@@ -0,0 +1,32 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * json.h - NDJSON records writer header file
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <stddef.h>
+#include "emit.h"
+
+/* a JSON object being written on a line of its own */
+struct json_record {
+    struct emitter *em;         /* output */
+    int fields;                 /* fields written so far */
+};
+
+void json_begin(struct json_record *r, struct emitter *em);
+void json_string(struct json_record *r, const char *key, const char *value);
+void json_number(struct json_record *r, const char *key,
+                 unsigned long long value);
+void json_bool(struct json_record *r, const char *key, int value);
+void json_hex(struct json_record *r, const char *key,
+              const unsigned char *data, size_t len);
+void json_end(struct json_record *r);
+
+#endif /* #ifndef JSON_H */
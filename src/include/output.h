@@ -0,0 +1,47 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * output.h - standard output backend header file
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include "emit.h"
+
+#define OUTPUT_PIPE_SIZE    (1 << 20)   /* pipe capacity asked for */
+
+struct output {
+    FILE *stream;               /* output stream */
+    int fd;                     /* file descriptor of 'stream' */
+    int splice;                 /* pages are spliced into a pipe */
+    char *pages;                /* page-aligned buffer handed to the pipe */
+    char *pages_end;            /* end of the region 'pages' is carved from */
+    struct emitter *em;         /* emitter formatting straight in 'pages' */
+    unsigned long long spliced; /* bytes given to the pipe without a copy */
+    unsigned long long copied;  /* bytes copied before being spliced */
+};
+
+/* output file of a size known in advance, mapped in memory */
+struct output_file {
+    const char *name;
+    int fd;
+    char *data;                 /* mapped file content */
+    size_t size;                /* file size in bytes */
+};
+
+void output_open(struct output *out, FILE *stream);
+void output_write(void *ctx, const char *data, size_t len);
+void output_attach(struct output *out, struct emitter *em);
+void output_detach(struct output *out);
+void output_close(struct output *out);
+void output_file_create(struct output_file *f, const char *filename,
+                        size_t size);
+void output_file_close(struct output_file *f);
+
+#endif /* #ifndef OUTPUT_H */
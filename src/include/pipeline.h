@@ -0,0 +1,68 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * pipeline.h - reader, encoder and writer threads pipeline header file
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include "alloc.h"
+#include "emit.h"
+#include "output.h"
+#include "reader.h"
+
+#define SPSC_RING_SIZE          64  /* ring slots, a power of two */
+#define PIPELINE_INPUT_BUFFERS  16  /* READER_BLOCK_SIZE input buffers */
+#define PIPELINE_OUTPUT_BUFFERS 32  /* EMIT_BUFFER_SIZE output buffers */
+
+/* single-producer, single-consumer ring of pointers */
+struct spsc_ring {
+    /* each index is written by one side only, on a cache line of its own */
+    unsigned int head __attribute__((aligned(64)));
+    unsigned int tail __attribute__((aligned(64)));
+    unsigned int waiting;       /* the consumer sleeps on 'tail' */
+    unsigned int closed;        /* nothing more will be pushed */
+    void *slots[SPSC_RING_SIZE];
+};
+
+struct pipeline_buffer {
+    struct reader_block blk;    /* input block, 'data' points to 'data' */
+    char *data;
+    size_t len;                 /* output bytes in 'data' */
+};
+
+struct pipeline {
+    struct reader *rd;
+    struct output *out;
+    struct emitter *em;
+    struct spsc_ring filled;    /* input buffers, reader to encoder */
+    struct spsc_ring empty;     /* input buffers, encoder to reader */
+    struct spsc_ring written;   /* output buffers, encoder to writer */
+    struct spsc_ring spare;     /* output buffers, writer to encoder */
+    struct pipeline_buffer inputs[PIPELINE_INPUT_BUFFERS];
+    struct pipeline_buffer outputs[PIPELINE_OUTPUT_BUFFERS];
+    struct pipeline_buffer *input;  /* input buffer lent to the encoder */
+    struct pipeline_buffer *output; /* output buffer of the emitter */
+    char *em_buf;               /* the emitter's own buffer */
+    struct arena arena;         /* holds the buffers */
+    pthread_t reader_thread;
+    pthread_t writer_thread;
+};
+
+void spsc_init(struct spsc_ring *r);
+void spsc_push(struct spsc_ring *r, void *item);
+void * spsc_pop(struct spsc_ring *r);
+void spsc_close(struct spsc_ring *r);
+void pipeline_open(struct pipeline *p, struct reader *rd, struct output *out,
+                   struct emitter *em);
+int pipeline_next(struct pipeline *p, struct reader_block *blk);
+void pipeline_close(struct pipeline *p);
+
+#endif /* #ifndef PIPELINE_H */
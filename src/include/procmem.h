@@ -0,0 +1,35 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * procmem.h - live process memory reading header file
+ */
+
+#ifndef PROCMEM_H
+#define PROCMEM_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#define PROC_PATH_LENGTH    512     /* max length of a mapped file path */
+
+/* a mapping of a process, as listed in /proc/PID/maps */
+struct proc_region {
+    unsigned long long start;
+    unsigned long long end;
+    char perms[5];              /* "r-xp" and the like */
+    unsigned long long offset;  /* offset in the mapped file */
+    char path[PROC_PATH_LENGTH];
+};
+
+FILE * proc_open_maps(pid_t pid);
+int proc_next_region(FILE *maps, struct proc_region *region);
+int proc_find_region(pid_t pid, unsigned long long address,
+                     struct proc_region *region);
+size_t proc_read(pid_t pid, unsigned long long address, void *buf,
+                 size_t len);
+
+#endif /* #ifndef PROCMEM_H */
@@ -0,0 +1,68 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * reader.h - asynchronous block reader header file
+ */
+
+#ifndef READER_H
+#define READER_H
+
+#include <stddef.h>
+#include "alloc.h"
+
+#define READER_BLOCK_SIZE   (256 << 10) /* bytes per read request */
+#define READER_QUEUE_DEPTH  64          /* read requests kept in flight */
+
+/* a block of input returned by reader_next() */
+struct reader_block {
+    int file;                   /* index of the file in the input list */
+    unsigned long long offset;  /* offset of the block in the file */
+    const unsigned char *data;  /* block content */
+    size_t len;                 /* block length in bytes */
+    int last;                   /* last block of the file */
+};
+
+struct reader_file {
+    const char *name;
+    int fd;                     /* file descriptor, -1 if not open */
+    unsigned long long size;    /* file size, regular files only */
+    int regular;                /* blocks can be read at any offset */
+};
+
+struct reader_slot {
+    int file;                   /* index of the file in the input list */
+    unsigned long long offset;  /* offset of the block in the file */
+    size_t want;                /* bytes requested */
+    size_t len;                 /* bytes read so far */
+    int last;                   /* last block of the file */
+    int state;                  /* one of the SLOT_* states */
+};
+
+struct uring;
+
+struct reader {
+    struct reader_file *files;
+    int nfiles;
+    int next_file;              /* file of the next block to request */
+    unsigned long long next_offset; /* offset of the next block to request */
+    int stalled;                /* waiting on a stream, its size unknown */
+    unsigned long long head;    /* sequence number of the next block out */
+    unsigned long long tail;    /* sequence number of the next request */
+    int busy;                   /* the head block is lent to the caller */
+    int depth;                  /* requests in flight, within the budget */
+    unsigned char *buffers;     /* 'depth' blocks */
+    struct arena arena;         /* holds 'buffers' */
+    struct reader_slot slots[READER_QUEUE_DEPTH];
+    struct uring *ring;         /* io_uring queues, NULL to use pread() */
+};
+
+void reader_open(struct reader *r, char **filenames, int nfiles);
+int reader_next(struct reader *r, struct reader_block *blk);
+const char *reader_engine(const struct reader *r);
+void reader_close(struct reader *r);
+
+#endif /* #ifndef READER_H */
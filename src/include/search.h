@@ -0,0 +1,60 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * search.h - multi-pattern byte search header file
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>
+
+/* a byte pattern, bits cleared in 'mask' are wildcards */
+struct search_pattern {
+    unsigned char *value;       /* pattern bytes */
+    unsigned char *mask;        /* 0xff fixed, 0xf0/0x0f nibble, 0 any */
+    size_t len;                 /* pattern length in bytes */
+    char *text;                 /* normalized pattern text */
+    size_t anchor;              /* offset of the anchor factor */
+    size_t anchor_len;          /* length of the anchor factor, 0 if none */
+    int next;                   /* next pattern sharing the same factor */
+};
+
+/* Aho-Corasick automaton over the anchor factors of the patterns */
+struct searcher {
+    struct search_pattern *patterns;
+    int npatterns;
+    size_t max_len;             /* longest pattern length */
+    int *delta;                 /* transitions, 256 per state */
+    int *output;                /* first pattern whose factor ends here */
+    int *dict;                  /* next state on the suffix chain with an
+                                   output, 0 if none */
+    int *depth;                 /* length of the prefix of each state */
+    int nstates;
+    int *unanchored;            /* patterns without any fixed byte */
+    int nunanchored;
+    unsigned char first[256];   /* bytes starting an anchor factor, 2 if
+                                   a single byte factor */
+    unsigned char single[256];  /* single byte factors */
+    unsigned char pairs[8192];  /* bitmap of factors' first two bytes */
+    unsigned char first_bytes[8];   /* the same bytes, when few */
+    int nfirst;                 /* number of distinct first bytes */
+};
+
+struct search_hit {
+    unsigned long long offset;  /* match offset in the input */
+    int pattern;                /* index of the matching pattern */
+};
+
+void searcher_init(struct searcher *s);
+int searcher_add(struct searcher *s, const char *text);
+void searcher_compile(struct searcher *s);
+void searcher_free(struct searcher *s);
+size_t search_buffer(const struct searcher *s, const unsigned char *data,
+                     size_t size, int nthreads, struct search_hit **hits);
+
+#endif /* #ifndef SEARCH_H */
@@ -0,0 +1,43 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * sparse.h - byte runs and holes detection header file
+ */
+
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <stddef.h>
+#include "input.h"
+
+#define ZERO_RUN_MIN        4096    /* default shortest zero run */
+#define BYTE_RUN_MIN        64      /* default shortest run of any byte */
+
+/* state of a scan for byte runs through a mapped input */
+struct run_scanner {
+    const struct input_map *map;
+    size_t min;                 /* shortest run reported */
+    int any_byte;               /* runs of any byte, not only zeros */
+    size_t hole_start;          /* next hole of the file */
+    size_t hole_end;
+    unsigned long long holes;   /* bytes of holes skipped */
+};
+
+/* a run of a repeated byte */
+struct byte_run {
+    size_t start;
+    size_t end;
+    unsigned char byte;
+};
+
+void run_scanner_init(struct run_scanner *rs, const struct input_map *map,
+                      size_t min, int any_byte);
+int next_byte_run(struct run_scanner *rs, size_t pos, struct byte_run *run);
+size_t byte_run_length(const unsigned char *data, size_t len,
+                       unsigned char byte);
+
+#endif /* #ifndef SPARSE_H */
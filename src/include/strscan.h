@@ -0,0 +1,40 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * strscan.h - printable strings scanner header file
+ */
+
+#ifndef STRSCAN_H
+#define STRSCAN_H
+
+#include <stddef.h>
+
+/* string encodings searched by the scanner */
+#define STRSCAN_ASCII       0x01    /* 7-bit printable characters */
+#define STRSCAN_UTF16LE     0x02    /* printable characters + null byte */
+
+#define STRSCAN_MIN_LENGTH  4       /* default minimum string length */
+
+/* callback receiving each string found at offset 'offset' of the input,
+ * 'len' is the string length in bytes (twice its length in characters for
+ * UTF-16LE strings).
+ */
+typedef void (*strscan_hit_fn)(void *ctx, unsigned long long offset,
+                               const unsigned char *data, size_t len,
+                               int encoding);
+
+struct strscan {
+    int encodings;              /* STRSCAN_ASCII and/or STRSCAN_UTF16LE */
+    size_t min_length;          /* minimum length in characters */
+    strscan_hit_fn hit;         /* called for every string found */
+    void *ctx;                  /* callback context */
+};
+
+void scan_printable_strings(const unsigned char *data, size_t size,
+                            const struct strscan *scan);
+
+#endif /* #ifndef STRSCAN_H */
@@ -0,0 +1,22 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * thread.h - worker threads helpers header file
+ */
+
+#ifndef THREAD_H
+#define THREAD_H
+
+#define MAX_THREADS         256     /* upper bound of worker threads */
+
+/* worker function called with its index among 'nthreads' workers */
+typedef void (*thread_fn)(void *ctx, int index, int nthreads);
+
+int default_thread_count(void);
+void run_threads(thread_fn fn, void *ctx, int nthreads);
+
+#endif /* #ifndef THREAD_H */
@@ -0,0 +1,24 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ */
+
+/*
+ * watch.h - input file change notification header file
+ */
+
+#ifndef WATCH_H
+#define WATCH_H
+
+struct watch {
+    int fd;                     /* inotify instance */
+    int wd;                     /* watch of the file's directory */
+    char *name;                 /* file name within its directory */
+};
+
+void watch_open(struct watch *w, const char *filename);
+void watch_wait(struct watch *w);
+void watch_close(struct watch *w);
+
+#endif /* #ifndef WATCH_H */
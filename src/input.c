@@ -0,0 +1,150 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * input.c - memory-mapped input
+ *
+ * Regular files are mapped read-only in memory so scanners can walk through
+ * them without copying. Pipes, terminals and other special files cannot be
+ * mapped, their content is read in a heap buffer instead, as is the output of
+ * decompressed files.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "include/alloc.h"
+#include "include/decompress.h"
+#include "include/input.h"
+
+#define INPUT_READ_CHUNK    65536   /* read size for non-mappable inputs */
+
+static void read_input_fd(int fd, struct input_map *map)
+{
+    size_t capacity = INPUT_READ_CHUNK;
+    ssize_t n;
+
+    /* the buffer is the only allocation of its arena, so it is remapped
+     * larger rather than copied as it grows.
+     */
+    arena_init(&map->arena, ARENA_BLOCK_SIZE);
+    map->data = (unsigned char *)arena_alloc(&map->arena, capacity);
+    map->size = 0;
+    map->mapped = 0;
+
+    /* read until end-of-file, doubling the buffer as it fills up */
+    for (;;) {
+        if (map->size == capacity) {
+            capacity *= 2;
+            /* inputs read whole can't grow past the memory limit */
+            if (memory_exceeded(capacity)) {
+                printf("Error: input is larger than the memory limit, it "
+                       "cannot be read whole.\n");
+                exit(EXIT_FAILURE);
+            }
+            map->data = (unsigned char *)arena_grow(&map->arena, map->data,
+                                                    map->size, capacity);
+        }
+        n = read(fd, map->data + map->size, capacity - map->size);
+        if (n == 0)
+            break;
+        if (n < 0) {
+            perror("read");
+            exit(EXIT_FAILURE);
+        }
+        map->size += n;
+    }
+}
+
+void map_input(const char *filename, struct input_map *map)
+{
+    char error[64];
+    struct stat st;
+    int fd = STDIN_FILENO;
+
+    /* a NULL filename stands for the standard input */
+    if (filename != NULL) {
+        fd = open(filename, O_RDONLY);
+        if (fd < 0) {
+            printf("Error: input filename \"%s\" cannot be read.\n",
+                   filename);
+            exit(EXIT_FAILURE);
+        }
+        /* compressed files are read through their decompressor */
+        fd = decompress_fd(filename, fd);
+    }
+
+    /* only non-empty regular files can be mapped */
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        map->data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map->data != MAP_FAILED) {
+            map->size = st.st_size;
+            map->mapped = 1;
+            /* input is scanned front to back, its holes are looked up
+             * with the file kept open.
+             */
+            madvise(map->data, map->size, MADV_SEQUENTIAL);
+            map->fd = fd;
+            return;
+        }
+    }
+
+    read_input_fd(fd, map);
+    if (decompress_finish(fd, error, sizeof(error)) != 0) {
+        printf("Error: input filename \"%s\": %s.\n", filename, error);
+        exit(EXIT_FAILURE);
+    }
+    map->fd = -1;
+    if (fd != STDIN_FILENO)
+        close(fd);
+}
+
+void unmap_input(struct input_map *map)
+{
+    if (map->mapped) {
+        munmap(map->data, map->size);
+        if (map->fd != STDIN_FILENO)
+            close(map->fd);
+    } else
+        arena_release(&map->arena);
+    map->data = NULL;
+    map->size = 0;
+}
+
+void input_next_hole(const struct input_map *map, size_t pos,
+                     size_t *hole_start, size_t *hole_end)
+{
+    off_t start, end;
+
+    /* the first hole at or after 'pos', or an empty one at the end. only
+     * sparse files on filesystems supporting SEEK_HOLE have holes.
+     */
+    *hole_start = *hole_end = map->size;
+    if (map->mapped == 0 || pos >= map->size)
+        return;
+    start = lseek(map->fd, pos, SEEK_HOLE);
+    if (start < 0 || (size_t)start >= map->size)
+        return;
+    end = lseek(map->fd, start, SEEK_DATA);
+    *hole_start = start;
+    *hole_end = end < 0 || (size_t)end > map->size ? map->size : end;
+}
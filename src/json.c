@@ -0,0 +1,152 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * json.c - NDJSON records writer
+ *
+ * Records are JSON objects written one per line (newline delimited JSON),
+ * field by field, straight into an emitter buffer: nothing is allocated nor
+ * built ahead, and a record of any size is streamed as it is written.
+ *
+ * Strings are file names, which may hold any byte: bytes that are not part
+ * of valid UTF-8 are replaced with U+FFFD, so that records stay valid JSON.
+ * The mapping is lossy, such names can't be told apart from the output.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "include/emit.h"
+#include "include/json.h"
+
+static int utf8_length(const unsigned char *s)
+{
+    int len, i;
+
+    /* length of the UTF-8 sequence at 's', 0 if it is invalid: overlong
+     * forms, surrogates and code points past U+10FFFF are rejected.
+     */
+    if (s[0] < 0x80)
+        return 1;
+    if (s[0] >= 0xc2 && s[0] <= 0xdf)
+        len = 2;
+    else if (s[0] >= 0xe0 && s[0] <= 0xef)
+        len = 3;
+    else if (s[0] >= 0xf0 && s[0] <= 0xf4)
+        len = 4;
+    else
+        return 0;
+    if ((s[0] == 0xe0 && s[1] < 0xa0) || (s[0] == 0xed && s[1] > 0x9f) ||
+        (s[0] == 0xf0 && s[1] < 0x90) || (s[0] == 0xf4 && s[1] > 0x8f))
+        return 0;
+    for (i = 1; i < len; i++) {
+        if ((s[i] & 0xc0) != 0x80)
+            return 0;
+    }
+    return len;
+}
+
+static void json_quoted(struct emitter *em, const char *s)
+{
+    char escape[8];
+    const char *run;
+    int len;
+
+    /* quotes, backslashes and control characters are escaped, invalid
+     * UTF-8 bytes replaced, anything else is copied in runs.
+     */
+    emit_write(em, "\"", 1);
+    while (*s != '\0') {
+        for (run = s; *s != '\0' && *s != '"' && *s != '\\' &&
+                      (unsigned char)*s >= 0x20; s += len) {
+            len = utf8_length((const unsigned char *)s);
+            if (len == 0)
+                break;
+        }
+        emit_write(em, run, s - run);
+        if (*s == '\0')
+            break;
+        if ((unsigned char)*s >= 0x80) {
+            emit_write(em, "\\ufffd", 6);
+        } else if (*s == '"' || *s == '\\') {
+            escape[0] = '\\';
+            escape[1] = *s;
+            emit_write(em, escape, 2);
+        } else {
+            snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char)*s);
+            emit_write(em, escape, 6);
+        }
+        s++;
+    }
+    emit_write(em, "\"", 1);
+}
+
+static void json_key(struct json_record *r, const char *key)
+{
+    if (r->fields++ > 0)
+        emit_write(r->em, ",", 1);
+    json_quoted(r->em, key);
+    emit_write(r->em, ":", 1);
+}
+
+void json_begin(struct json_record *r, struct emitter *em)
+{
+    r->em = em;
+    r->fields = 0;
+    emit_write(em, "{", 1);
+}
+
+void json_string(struct json_record *r, const char *key, const char *value)
+{
+    json_key(r, key);
+    json_quoted(r->em, value);
+}
+
+void json_number(struct json_record *r, const char *key,
+                 unsigned long long value)
+{
+    char text[24];
+    int n;
+
+    json_key(r, key);
+    n = snprintf(text, sizeof(text), "%llu", value);
+    emit_write(r->em, text, n);
+}
+
+void json_bool(struct json_record *r, const char *key, int value)
+{
+    json_key(r, key);
+    if (value != 0)
+        emit_write(r->em, "true", 4);
+    else
+        emit_write(r->em, "false", 5);
+}
+
+void json_hex(struct json_record *r, const char *key,
+              const unsigned char *data, size_t len)
+{
+    /* bytes as a string of hexadecimal digits */
+    json_key(r, key);
+    emit_write(r->em, "\"", 1);
+    emit_hex_digits(r->em, data, len);
+    emit_write(r->em, "\"", 1);
+}
+
+void json_end(struct json_record *r)
+{
+    emit_write(r->em, "}\n", 2);
+}
@@ -0,0 +1,283 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * output.c - standard output backend
+ *
+ * When the output is a pipe, formatted buffers are handed to the kernel with
+ * vmsplice(), which maps their pages in the pipe instead of copying them.
+ * A spliced page must not be modified while anything still refers to it,
+ * and a reader splicing from the pipe may hold on to it long after the pipe
+ * has been drained. Spliced pages are therefore gifted and unmapped, never
+ * written again: buffers are carved in turn out of freshly mapped regions.
+ *
+ * An attached emitter formats its output straight into the ring, other data
+ * is copied in first. Anything else than a pipe, or a kernel refusing
+ * vmsplice(), goes through the stdio stream.
+ *
+ * Outputs whose size is known before they are formatted can be written to a
+ * file instead: its blocks are allocated at once and it is mapped in memory
+ * for the encoders to write their part of it in place.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "include/alloc.h"
+#include "include/emit.h"
+#include "include/output.h"
+
+#define OUTPUT_PAGE_SIZE    4096    /* splice granularity */
+#define OUTPUT_REGION_SIZE  (1 << 20) /* pages mapped at once for the pipe */
+
+static void write_all(struct output *out, const char *data, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(out->fd, data, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            perror("write");
+            exit(EXIT_FAILURE);
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+static void splice_out(struct output *out, const char *data, size_t len)
+{
+    struct iovec iov;
+    ssize_t n;
+
+    while (len > 0) {
+        iov.iov_base = (void *)data;
+        iov.iov_len = len;
+        n = vmsplice(out->fd, &iov, 1, SPLICE_F_GIFT);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            /* vmsplice() isn't supported, fall back to plain writes */
+            out->splice = 0;
+            write_all(out, data, len);
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+static int map_region(struct output *out)
+{
+    /* the pages are faulted in at once rather than one by one */
+    out->pages = mmap(NULL, OUTPUT_REGION_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (out->pages == MAP_FAILED) {
+        out->pages = NULL;
+        out->pages_end = NULL;
+        return -1;
+    }
+    out->pages_end = out->pages + OUTPUT_REGION_SIZE;
+    return 0;
+}
+
+static void next_buffer(struct output *out, size_t used)
+{
+    size_t size;
+
+    /* buffers start on a page boundary. the pages just spliced belong to
+     * the pipe, the pipe keeps its own references to them once unmapped.
+     */
+    size = (used + OUTPUT_PAGE_SIZE - 1) & ~(size_t)(OUTPUT_PAGE_SIZE - 1);
+    if (size > 0)
+        munmap(out->pages, size);
+    out->pages += size;
+    if ((size_t)(out->pages_end - out->pages) < EMIT_BUFFER_SIZE) {
+        if (out->pages < out->pages_end)
+            munmap(out->pages, out->pages_end - out->pages);
+        if (map_region(out) != 0) {
+            /* out of mappings, the output goes through the stream */
+            out->splice = 0;
+            if (out->em != NULL) {
+                out->em->buf = allocate_dynamic_memory(EMIT_BUFFER_SIZE);
+                out->em->size = EMIT_BUFFER_SIZE;
+            }
+            return;
+        }
+    }
+    if (out->em != NULL) {
+        out->em->buf = out->pages;
+        out->em->size = EMIT_BUFFER_SIZE;
+    }
+}
+
+void output_open(struct output *out, FILE *stream)
+{
+    struct stat st;
+    int pipe_size;
+
+    memset(out, 0, sizeof(*out));
+    out->stream = stream;
+    out->fd = fileno(stream);
+
+    if (fstat(out->fd, &st) != 0 || !S_ISFIFO(st.st_mode))
+        return;
+
+    /* a larger pipe holds more pages in flight, it's fine if we can't */
+    fcntl(out->fd, F_SETPIPE_SZ, OUTPUT_PIPE_SIZE);
+    pipe_size = fcntl(out->fd, F_GETPIPE_SZ);
+    if (pipe_size <= 0)
+        return;
+
+    if (map_region(out) != 0)
+        return;
+    out->splice = 1;
+}
+
+void output_write(void *ctx, const char *data, size_t len)
+{
+    struct output *out = ctx;
+    size_t n;
+
+    if (out->splice == 0) {
+        fwrite(data, sizeof(char), len, out->stream);
+        return;
+    }
+
+    /* what has been printed so far goes first */
+    fflush(out->stream);
+
+    /* the emitter's own buffer is already in the ring */
+    if (out->em != NULL && data == out->em->buf) {
+        splice_out(out, data, len);
+        out->spliced += len;
+        next_buffer(out, len);
+        return;
+    }
+
+    /* pending emitter output precedes 'data' */
+    if (out->em != NULL && out->em->len > 0)
+        emit_flush(out->em);
+
+    while (len > 0) {
+        n = len < EMIT_BUFFER_SIZE ? len : EMIT_BUFFER_SIZE;
+        memcpy(out->pages, data, n);
+        splice_out(out, out->pages, n);
+        out->copied += n;
+        next_buffer(out, n);
+        if (out->splice == 0) {
+            fwrite(data + n, sizeof(char), len - n, out->stream);
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+void output_attach(struct output *out, struct emitter *em)
+{
+    out->em = em;
+    em->flush = output_write;
+    em->ctx = out;
+    if (out->splice) {
+        free(em->buf);
+        em->buf = out->pages;
+        em->size = EMIT_BUFFER_SIZE;
+    }
+}
+
+void output_detach(struct output *out)
+{
+    struct emitter *em = out->em;
+
+    if (em == NULL)
+        return;
+
+    /* hand the emitter back a buffer of its own */
+    emit_flush(em);
+    if (out->pages != NULL && em->buf == out->pages) {
+        em->buf = allocate_dynamic_memory(EMIT_BUFFER_SIZE);
+        em->size = EMIT_BUFFER_SIZE;
+    }
+    em->flush = emit_flush_stream;
+    em->ctx = out->stream;
+    out->em = NULL;
+}
+
+void output_close(struct output *out)
+{
+    output_detach(out);
+    /* the pipe holds its own references to the pages still unread */
+    if (out->pages != NULL)
+        munmap(out->pages, out->pages_end - out->pages);
+    out->pages = NULL;
+    out->pages_end = NULL;
+    out->splice = 0;
+    fflush(out->stream);
+}
+
+static void output_file_error(struct output_file *f)
+{
+    printf("Error: output filename \"%s\" cannot be written.\n", f->name);
+    exit(EXIT_FAILURE);
+}
+
+void output_file_create(struct output_file *f, const char *filename,
+                        size_t size)
+{
+    f->name = filename;
+    f->size = size;
+    f->data = NULL;
+    f->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (f->fd < 0)
+        output_file_error(f);
+    if (size == 0)
+        return;
+
+    /* allocate all blocks up front, so the file isn't fragmented by
+     * concurrent writers and a full disk is reported now rather than by a
+     * SIGBUS. filesystems without fallocate() are only extended.
+     */
+    errno = posix_fallocate(f->fd, 0, size);
+    if (errno == ENOSPC || errno == EFBIG)
+        output_file_error(f);
+    if (ftruncate(f->fd, size) != 0)
+        output_file_error(f);
+
+    f->data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, 0);
+    if (f->data == MAP_FAILED)
+        output_file_error(f);
+}
+
+void output_file_close(struct output_file *f)
+{
+    if (f->data != NULL)
+        munmap(f->data, f->size);
+    if (close(f->fd) != 0)
+        output_file_error(f);
+    f->data = NULL;
+}
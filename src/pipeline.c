@@ -0,0 +1,276 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * pipeline.c - reader, encoder and writer threads pipeline
+ *
+ * A reader thread copies the blocks of the input files to free input
+ * buffers, the calling thread encodes them into output buffers, and a writer
+ * thread hands those to the output backend. Buffers go from one stage to the
+ * next, and back once they are done with, through single-producer,
+ * single-consumer rings: every ring is large enough to hold all the buffers
+ * it carries, so a push never waits, and a pop spins shortly before sleeping
+ * on a futex until the producer pushes again.
+ *
+ * Disk reads, encoding and output writes all overlap, even with a single
+ * encoding thread, and a slow output doesn't stall reading. The number of
+ * buffers is fixed when the pipeline opens, so a stage running ahead waits
+ * for buffers rather than allocating more.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include "include/alloc.h"
+#include "include/emit.h"
+#include "include/output.h"
+#include "include/reader.h"
+#include "include/pipeline.h"
+
+#define SPSC_SPINS  128     /* empty ring polls before sleeping */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax()     __builtin_ia32_pause()
+#else
+#define cpu_relax()     do { } while (0)
+#endif
+
+static void futex_wait(unsigned int *addr, unsigned int value)
+{
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void futex_wake(unsigned int *addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+void spsc_init(struct spsc_ring *r)
+{
+    memset(r, 0, sizeof(*r));
+}
+
+void spsc_push(struct spsc_ring *r, void *item)
+{
+    unsigned int tail = r->tail;
+
+    r->slots[tail & (SPSC_RING_SIZE - 1)] = item;
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&r->waiting, __ATOMIC_SEQ_CST))
+        futex_wake(&r->tail);
+}
+
+void spsc_close(struct spsc_ring *r)
+{
+    __atomic_store_n(&r->closed, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&r->waiting, __ATOMIC_SEQ_CST))
+        futex_wake(&r->tail);
+}
+
+void * spsc_pop(struct spsc_ring *r)
+{
+    unsigned int head = r->head, tail;
+    void *item;
+    int spins = 0;
+
+    for (;;) {
+        tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        if (tail != head)
+            break;
+        if (__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE)) {
+            /* items pushed before the ring was closed come first */
+            if (__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) != head)
+                continue;
+            return NULL;
+        }
+        if (spins++ < SPSC_SPINS) {
+            cpu_relax();
+            continue;
+        }
+        /* announce the sleep, then make sure nothing came meanwhile */
+        __atomic_store_n(&r->waiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&r->tail, __ATOMIC_SEQ_CST) == head &&
+            !__atomic_load_n(&r->closed, __ATOMIC_SEQ_CST))
+            futex_wait(&r->tail, head);
+        __atomic_store_n(&r->waiting, 0, __ATOMIC_SEQ_CST);
+    }
+
+    item = r->slots[head & (SPSC_RING_SIZE - 1)];
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    return item;
+}
+
+static void *reader_stage(void *arg)
+{
+    struct pipeline *p = arg;
+    struct pipeline_buffer *b;
+    struct reader_block blk;
+
+    while (reader_next(p->rd, &blk)) {
+        b = spsc_pop(&p->empty);
+        memcpy(b->data, blk.data, blk.len);
+        b->blk = blk;
+        b->blk.data = (const unsigned char *)b->data;
+        spsc_push(&p->filled, b);
+    }
+    spsc_close(&p->filled);
+    return NULL;
+}
+
+static void *writer_stage(void *arg)
+{
+    struct pipeline *p = arg;
+    struct pipeline_buffer *b;
+
+    while ((b = spsc_pop(&p->written)) != NULL) {
+        output_write(p->out, b->data, b->len);
+        spsc_push(&p->spare, b);
+    }
+    return NULL;
+}
+
+static void pipeline_write(void *ctx, const char *data, size_t len)
+{
+    struct pipeline *p = ctx;
+    struct emitter *em = p->em;
+    size_t n;
+
+    /* the emitter's buffer is handed over as is, others are copied */
+    if (data == p->output->data) {
+        p->output->len = len;
+        spsc_push(&p->written, p->output);
+        p->output = spsc_pop(&p->spare);
+        em->buf = p->output->data;
+        return;
+    }
+
+    /* pending emitter output precedes 'data' */
+    if (em->len > 0)
+        emit_flush(em);
+
+    while (len > 0) {
+        n = len < EMIT_BUFFER_SIZE ? len : EMIT_BUFFER_SIZE;
+        memcpy(p->output->data, data, n);
+        p->output->len = n;
+        spsc_push(&p->written, p->output);
+        p->output = spsc_pop(&p->spare);
+        em->buf = p->output->data;
+        data += n;
+        len -= n;
+    }
+}
+
+static void start_thread(pthread_t *thread, void *(*fn)(void *), void *arg)
+{
+    if (pthread_create(thread, NULL, fn, arg) != 0) {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void pipeline_open(struct pipeline *p, struct reader *rd, struct output *out,
+                   struct emitter *em)
+{
+    size_t size = PIPELINE_INPUT_BUFFERS * READER_BLOCK_SIZE +
+                  PIPELINE_OUTPUT_BUFFERS * EMIT_BUFFER_SIZE;
+    size_t budget = memory_budget(size);
+    int i, ninputs, noutputs;
+
+    p->rd = rd;
+    p->out = out;
+    p->em = em;
+    spsc_init(&p->filled);
+    spsc_init(&p->empty);
+    spsc_init(&p->written);
+    spsc_init(&p->spare);
+
+    /* under a memory limit, there are proportionally fewer buffers of
+     * each kind, and the stages wait for each other more often.
+     */
+    ninputs = (unsigned long long)PIPELINE_INPUT_BUFFERS * budget / size;
+    if (ninputs < 2)
+        ninputs = 2;
+    noutputs = (unsigned long long)PIPELINE_OUTPUT_BUFFERS * budget / size;
+    if (noutputs < 2)
+        noutputs = 2;
+
+    /* all the buffers fit in one block */
+    arena_init(&p->arena, ninputs * READER_BLOCK_SIZE +
+                          noutputs * EMIT_BUFFER_SIZE);
+    for (i = 0; i < ninputs; i++) {
+        p->inputs[i].data = arena_alloc(&p->arena, READER_BLOCK_SIZE);
+        spsc_push(&p->empty, &p->inputs[i]);
+    }
+    for (i = 0; i < noutputs; i++) {
+        p->outputs[i].data = arena_alloc(&p->arena, EMIT_BUFFER_SIZE);
+        if (i > 0)
+            spsc_push(&p->spare, &p->outputs[i]);
+    }
+    p->input = NULL;
+
+    /* the emitter formats straight into the output buffers */
+    emit_flush(em);
+    p->em_buf = em->buf;
+    p->output = &p->outputs[0];
+    em->buf = p->output->data;
+    em->size = EMIT_BUFFER_SIZE;
+    em->flush = pipeline_write;
+    em->ctx = p;
+
+    start_thread(&p->reader_thread, reader_stage, p);
+    start_thread(&p->writer_thread, writer_stage, p);
+}
+
+int pipeline_next(struct pipeline *p, struct reader_block *blk)
+{
+    /* the previous block is done with */
+    if (p->input != NULL)
+        spsc_push(&p->empty, p->input);
+
+    p->input = spsc_pop(&p->filled);
+    if (p->input == NULL)
+        return 0;
+    *blk = p->input->blk;
+    return 1;
+}
+
+void pipeline_close(struct pipeline *p)
+{
+    struct emitter *em = p->em;
+    struct reader_block blk;
+
+    /* drain the blocks left, if the encoder stopped early */
+    while (pipeline_next(p, &blk))
+        ;
+    pthread_join(p->reader_thread, NULL);
+
+    emit_flush(em);
+    spsc_close(&p->written);
+    pthread_join(p->writer_thread, NULL);
+
+    /* the emitter gets its own buffer back, writing to the output */
+    em->buf = p->em_buf;
+    em->flush = output_write;
+    em->ctx = p->out;
+    arena_release(&p->arena);
+}
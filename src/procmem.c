@@ -0,0 +1,120 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * procmem.c - live process memory reading
+ *
+ * Memory of a running process is copied with process_vm_readv(), straight
+ * from its address space to ours, without stopping it nor going through a
+ * core file. The remote range is split in large iovecs, many of them being
+ * read by a single call. A call stops at the first iovec which cannot be
+ * read entirely, such as one crossing into an unmapped page, so iovecs are
+ * kept a fraction of the usual mapping sizes.
+ *
+ * The mappings of the process are listed in /proc/PID/maps.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "include/procmem.h"
+
+#define PROC_IOV_SIZE       (64 << 10)  /* bytes per remote iovec */
+#define PROC_IOV_COUNT      1024        /* remote iovecs per call */
+
+FILE * proc_open_maps(pid_t pid)
+{
+    char filename[64];
+
+    snprintf(filename, sizeof(filename), "/proc/%d/maps", (int)pid);
+    return fopen(filename, "r");
+}
+
+int proc_next_region(FILE *maps, struct proc_region *region)
+{
+    char line[PROC_PATH_LENGTH + 128];
+    int n;
+
+    /* start-end perms offset dev inode [path] */
+    while (fgets(line, sizeof(line), maps) != NULL) {
+        region->path[0] = '\0';
+        if (sscanf(line, "%llx-%llx %4s %llx %*s %*s %n", &region->start,
+                   &region->end, region->perms, &region->offset, &n) < 4)
+            continue;
+        snprintf(region->path, sizeof(region->path), "%s", line + n);
+        region->path[strcspn(region->path, "\n")] = '\0';
+        return 1;
+    }
+    return 0;
+}
+
+int proc_find_region(pid_t pid, unsigned long long address,
+                     struct proc_region *region)
+{
+    FILE *maps = proc_open_maps(pid);
+    int found = 0;
+
+    if (maps == NULL)
+        return -1;
+    while (found == 0 && proc_next_region(maps, region))
+        found = address >= region->start && address < region->end;
+    fclose(maps);
+    return found ? 0 : -1;
+}
+
+size_t proc_read(pid_t pid, unsigned long long address, void *buf,
+                 size_t len)
+{
+    struct iovec local, remote[PROC_IOV_COUNT];
+    size_t done = 0;
+    ssize_t n;
+    int i;
+
+    /* a single local buffer, the remote range in iovecs */
+    while (done < len) {
+        size_t left = len - done;
+
+        for (i = 0; i < PROC_IOV_COUNT && left > 0; i++) {
+            remote[i].iov_base = (void *)(uintptr_t)(address + done +
+                                                     (size_t)i *
+                                                     PROC_IOV_SIZE);
+            remote[i].iov_len = left < PROC_IOV_SIZE ? left : PROC_IOV_SIZE;
+            left -= remote[i].iov_len;
+        }
+        local.iov_base = (char *)buf + done;
+        local.iov_len = len - done - left;
+
+        n = process_vm_readv(pid, &local, 1, remote, i, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+        /* a short read stopped at an unreadable iovec */
+        if ((size_t)n < local.iov_len) {
+            errno = EFAULT;
+            break;
+        }
+    }
+    return done;
+}
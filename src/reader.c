@@ -0,0 +1,478 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * reader.c - asynchronous block reader
+ *
+ * A list of input files is read in blocks of READER_BLOCK_SIZE bytes, which
+ * are handed out in file and offset order. Up to READER_QUEUE_DEPTH block
+ * reads, across as many files as they span, are kept in flight with
+ * io_uring into buffers registered once with the kernel, so the next blocks
+ * and files are read while the current one is being encoded. Under a
+ * memory limit, fewer requests are kept in flight.
+ *
+ * Where io_uring is unavailable (old kernels, seccomp filters), the queued
+ * ranges are announced to the kernel read-ahead with posix_fadvise() and
+ * read with pread() when their turn comes.
+ *
+ * The size of special files (pipes, character devices) is unknown: they are
+ * read one block at a time until end-of-file, which is reported as an empty
+ * last block.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef __NR_io_uring_setup
+#include <linux/io_uring.h>
+#endif
+#include "include/alloc.h"
+#include "include/decompress.h"
+#include "include/reader.h"
+
+/* states of a block slot */
+#define SLOT_FREE           0       /* not in use */
+#define SLOT_PENDING        1       /* read requested */
+#define SLOT_READY          2       /* content available */
+
+static void read_error(struct reader *r, int file)
+{
+    printf("Error: input filename \"%s\" cannot be read.\n",
+           r->files[file].name);
+    exit(EXIT_FAILURE);
+}
+
+/* decompressors only report their errors once their output was read */
+static void finish_stream(struct reader *r, int file)
+{
+    char error[64];
+
+    if (decompress_finish(r->files[file].fd, error, sizeof(error)) != 0) {
+        printf("Error: input filename \"%s\": %s.\n", r->files[file].name,
+               error);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static unsigned char *slot_buffer(struct reader *r, int index)
+{
+    return r->buffers + (size_t)index * READER_BLOCK_SIZE;
+}
+
+#ifdef __NR_io_uring_setup
+
+struct uring {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+    unsigned queued;            /* requests not submitted yet */
+    int fixed;                  /* slot buffers are registered */
+    struct iovec iov[READER_QUEUE_DEPTH];
+};
+
+static int uring_enter(struct uring *u, unsigned submit, unsigned wait)
+{
+    return syscall(__NR_io_uring_enter, u->fd, submit, wait,
+                   wait > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+static void uring_free(struct uring *u)
+{
+    if (u->sqes != NULL && u->sqes != MAP_FAILED)
+        munmap(u->sqes, u->sqes_size);
+    if (u->cq_ring != NULL && u->cq_ring != MAP_FAILED &&
+        u->cq_ring != u->sq_ring)
+        munmap(u->cq_ring, u->cq_ring_size);
+    if (u->sq_ring != NULL && u->sq_ring != MAP_FAILED)
+        munmap(u->sq_ring, u->sq_ring_size);
+    close(u->fd);
+    free(u);
+}
+
+static struct uring *uring_setup(struct reader *r)
+{
+    struct io_uring_params p;
+    struct uring *u;
+    int i, fd;
+
+    memset(&p, 0, sizeof(p));
+    fd = syscall(__NR_io_uring_setup, r->depth, &p);
+    if (fd < 0)
+        return NULL;
+
+    u = (struct uring *)allocate_dynamic_memory(sizeof(*u));
+    memset(u, 0, sizeof(*u));
+    u->fd = fd;
+
+    /* map the submission and completion rings, and the submission entries.
+     * recent kernels share a single mapping between both rings.
+     */
+    u->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_ring_size = p.cq_off.cqes +
+                      p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_ring_size > u->sq_ring_size)
+            u->sq_ring_size = u->cq_ring_size;
+        u->cq_ring_size = u->sq_ring_size;
+    }
+    u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (u->sq_ring == MAP_FAILED) {
+        uring_free(u);
+        return NULL;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        u->cq_ring = u->sq_ring;
+    else
+        u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (u->cq_ring == MAP_FAILED || u->sqes == MAP_FAILED) {
+        uring_free(u);
+        return NULL;
+    }
+
+    u->sq_head = (unsigned *)((char *)u->sq_ring + p.sq_off.head);
+    u->sq_tail = (unsigned *)((char *)u->sq_ring + p.sq_off.tail);
+    u->sq_mask = (unsigned *)((char *)u->sq_ring + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)((char *)u->sq_ring + p.sq_off.array);
+    u->cq_head = (unsigned *)((char *)u->cq_ring + p.cq_off.head);
+    u->cq_tail = (unsigned *)((char *)u->cq_ring + p.cq_off.tail);
+    u->cq_mask = (unsigned *)((char *)u->cq_ring + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)((char *)u->cq_ring + p.cq_off.cqes);
+
+    /* register the slot buffers once, so the kernel doesn't have to map
+     * them on every request. plain vectored reads are used if the buffers
+     * cannot be locked in memory.
+     */
+    for (i = 0; i < r->depth; i++) {
+        u->iov[i].iov_base = slot_buffer(r, i);
+        u->iov[i].iov_len = READER_BLOCK_SIZE;
+    }
+    u->fixed = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+                       u->iov, r->depth) == 0;
+
+    return u;
+}
+
+static void uring_queue(struct uring *u, int index, int fd,
+                        unsigned char *buf, size_t len, long long offset)
+{
+    unsigned tail = *u->sq_tail;
+    unsigned i = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[i];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->user_data = index;
+    if (u->fixed) {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->addr = (unsigned long)buf;
+        sqe->len = len;
+        sqe->buf_index = index;
+    } else {
+        /* the slot's vector is rewritten, the slot is not reused before
+         * the request completes.
+         */
+        u->iov[index].iov_base = buf;
+        u->iov[index].iov_len = len;
+        sqe->opcode = IORING_OP_READV;
+        sqe->addr = (unsigned long)&u->iov[index];
+        sqe->len = 1;
+    }
+    u->sq_array[i] = i;
+
+    /* publish the entry to the kernel */
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    u->queued++;
+}
+
+#else /* #ifdef __NR_io_uring_setup */
+
+struct uring {
+    int fd;
+};
+
+#endif /* #ifdef __NR_io_uring_setup */
+
+static void open_file(struct reader *r, int file)
+{
+    struct reader_file *f = &r->files[file];
+    struct stat st;
+
+    f->fd = open(f->name, O_RDONLY);
+    if (f->fd < 0)
+        read_error(r, file);
+    /* compressed files are read through their decompressor */
+    f->fd = decompress_fd(f->name, f->fd);
+    if (fstat(f->fd, &st) != 0)
+        read_error(r, file);
+    f->regular = S_ISREG(st.st_mode);
+    f->size = f->regular ? (unsigned long long)st.st_size : 0;
+}
+
+static void request_block(struct reader *r, int index)
+{
+    struct reader_slot *s = &r->slots[index];
+    struct reader_file *f = &r->files[s->file];
+
+    s->state = SLOT_PENDING;
+#ifdef __NR_io_uring_setup
+    if (r->ring != NULL) {
+        uring_queue(r->ring, index, f->fd, slot_buffer(r, index) + s->len,
+                    s->want - s->len, f->regular ? (long long)
+                    (s->offset + s->len) : -1);
+        return;
+    }
+#endif
+    /* let the kernel read ahead while the previous blocks are processed */
+    if (f->regular)
+        posix_fadvise(f->fd, s->offset, s->want, POSIX_FADV_WILLNEED);
+}
+
+static void complete_block(struct reader *r, int index, long res)
+{
+    struct reader_slot *s = &r->slots[index];
+    struct reader_file *f = &r->files[s->file];
+
+    if (res < 0)
+        read_error(r, s->file);
+
+    if (!f->regular) {
+        /* a stream block is whatever a read returned, an empty read is its
+         * end-of-file. the next request can be made once its size is known.
+         */
+        s->len = res;
+        if (res == 0) {
+            finish_stream(r, s->file);
+            s->last = 1;
+            r->next_file++;
+            r->next_offset = 0;
+        } else {
+            r->next_offset += res;
+        }
+        r->stalled = 0;
+        s->state = SLOT_READY;
+        return;
+    }
+
+    s->len += res;
+    /* short reads are resumed, unless the file was truncated meanwhile */
+    if (res > 0 && s->len < s->want)
+        request_block(r, index);
+    else
+        s->state = SLOT_READY;
+}
+
+static void request_blocks(struct reader *r)
+{
+    while (r->tail - r->head < (unsigned long long)r->depth &&
+           r->next_file < r->nfiles && r->stalled == 0) {
+        int index = r->tail % r->depth;
+        struct reader_slot *s = &r->slots[index];
+        struct reader_file *f = &r->files[r->next_file];
+
+        if (f->fd < 0)
+            open_file(r, r->next_file);
+
+        s->file = r->next_file;
+        s->offset = r->next_offset;
+        s->len = 0;
+        r->tail++;
+
+        if (!f->regular) {
+            s->want = READER_BLOCK_SIZE;
+            s->last = 0;
+            r->stalled = 1;
+            request_block(r, index);
+            continue;
+        }
+
+        /* regular files are cut in blocks up front */
+        s->want = f->size - s->offset < READER_BLOCK_SIZE ?
+                  f->size - s->offset : READER_BLOCK_SIZE;
+        s->last = s->offset + s->want >= f->size;
+        if (s->last) {
+            r->next_file++;
+            r->next_offset = 0;
+        } else {
+            r->next_offset += s->want;
+        }
+        /* empty files have a single, empty block */
+        if (s->want == 0)
+            s->state = SLOT_READY;
+        else
+            request_block(r, index);
+    }
+
+#ifdef __NR_io_uring_setup
+    if (r->ring != NULL && r->ring->queued > 0) {
+        int n = uring_enter(r->ring, r->ring->queued, 0);
+        if (n > 0)
+            r->ring->queued -= n;
+    }
+#endif
+}
+
+static void wait_block(struct reader *r, int index)
+{
+    struct reader_slot *s = &r->slots[index];
+    struct reader_file *f = &r->files[s->file];
+    ssize_t n;
+
+#ifdef __NR_io_uring_setup
+    if (r->ring != NULL) {
+        struct uring *u = r->ring;
+        unsigned head;
+
+        /* submit what is still queued and wait for a completion */
+        if (uring_enter(u, u->queued, 1) < 0) {
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                read_error(r, s->file);
+        } else {
+            u->queued = 0;
+        }
+
+        /* reap every available completion, in any order */
+        head = *u->cq_head;
+        while (head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+            complete_block(r, (int)cqe->user_data, cqe->res);
+            head++;
+        }
+        __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+        return;
+    }
+#endif
+
+    /* synchronous fallback, only the head block is ever waited for */
+    do {
+        if (f->regular)
+            n = pread(f->fd, slot_buffer(r, index) + s->len,
+                      s->want - s->len, s->offset + s->len);
+        else
+            n = read(f->fd, slot_buffer(r, index), s->want);
+    } while (n < 0 && errno == EINTR);
+    complete_block(r, index, n < 0 ? -errno : n);
+}
+
+void reader_open(struct reader *r, char **filenames, int nfiles)
+{
+    int i;
+
+    memset(r, 0, sizeof(*r));
+    r->nfiles = nfiles;
+    r->files = (struct reader_file *)allocate_dynamic_memory(
+                   sizeof(struct reader_file) * (nfiles > 0 ? nfiles : 1));
+    for (i = 0; i < nfiles; i++) {
+        r->files[i].name = filenames[i];
+        r->files[i].fd = -1;
+        r->files[i].size = 0;
+        r->files[i].regular = 0;
+    }
+    /* the blocks live in an arena of their own, huge pages if asked for */
+    r->depth = memory_budget((size_t)READER_QUEUE_DEPTH * READER_BLOCK_SIZE) /
+               READER_BLOCK_SIZE;
+    if (r->depth < 2)
+        r->depth = 2;
+    arena_init(&r->arena, ARENA_BLOCK_SIZE);
+    r->buffers = (unsigned char *)arena_alloc(&r->arena,
+                     (size_t)r->depth * READER_BLOCK_SIZE);
+#ifdef __NR_io_uring_setup
+    r->ring = uring_setup(r);
+#endif
+}
+
+int reader_next(struct reader *r, struct reader_block *blk)
+{
+    struct reader_slot *s;
+    int index;
+
+    /* the block returned by the previous call is recycled, and its file
+     * closed if it was the last one.
+     */
+    if (r->busy) {
+        s = &r->slots[r->head % r->depth];
+        if (s->last) {
+            close(r->files[s->file].fd);
+            r->files[s->file].fd = -1;
+        }
+        s->state = SLOT_FREE;
+        r->head++;
+        r->busy = 0;
+    }
+
+    request_blocks(r);
+    if (r->head == r->tail)
+        return 0;
+
+    index = r->head % r->depth;
+    s = &r->slots[index];
+    while (s->state != SLOT_READY) {
+        wait_block(r, index);
+        /* a completed stream read lets the next block be requested */
+        request_blocks(r);
+    }
+
+    blk->file = s->file;
+    blk->offset = s->offset;
+    blk->data = slot_buffer(r, index);
+    blk->len = s->len;
+    blk->last = s->last;
+    r->busy = 1;
+    return 1;
+}
+
+const char *reader_engine(const struct reader *r)
+{
+    return r->ring != NULL ? "io_uring" : "pread";
+}
+
+void reader_close(struct reader *r)
+{
+    int i;
+
+#ifdef __NR_io_uring_setup
+    /* the ring goes first, it may still be reading into the buffers */
+    if (r->ring != NULL)
+        uring_free(r->ring);
+#endif
+    r->ring = NULL;
+    for (i = 0; i < r->nfiles; i++) {
+        if (r->files[i].fd >= 0)
+            close(r->files[i].fd);
+    }
+    free(r->files);
+    arena_release(&r->arena);
+    r->files = NULL;
+    r->buffers = NULL;
+}
@@ -0,0 +1,429 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * search.c - multi-pattern byte search
+ *
+ * Patterns are hexadecimal byte strings where '?' stands for any nibble,
+ * such as "ff e4", "5? c3" or "e8 ?? ?? ?? ??". The longest run of fully
+ * fixed bytes of each pattern, its anchor factor, is added to an
+ * Aho-Corasick automaton. Every factor found in the input is then verified
+ * against the whole pattern.
+ *
+ * While the automaton is in its root state, the input is skipped up to the
+ * next byte able to start a factor, with SSE2 compares when the factors
+ * start with only a few distinct bytes. The input is split among worker
+ * threads, each one searching an overlapping slice.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "include/alloc.h"
+#include "include/search.h"
+#include "include/thread.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define HITS_INITIAL_SIZE   1024    /* initial hits array length */
+
+struct search_job {
+    const struct searcher *s;
+    const unsigned char *data;
+    size_t size;
+    struct search_hit *hits[MAX_THREADS];
+    size_t nhits[MAX_THREADS];
+    size_t capacity[MAX_THREADS];
+};
+
+void searcher_init(struct searcher *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+int searcher_add(struct searcher *s, const char *text)
+{
+    struct search_pattern p;
+    size_t i, n = strlen(text), run = 0;
+    int hi, lo;
+
+    p.value = (unsigned char *)allocate_dynamic_memory(n / 2 + 1);
+    p.mask = (unsigned char *)allocate_dynamic_memory(n / 2 + 1);
+    p.text = allocate_dynamic_memory(n / 2 * 3 + 1);
+    p.len = 0;
+    p.anchor = 0;
+    p.anchor_len = 0;
+    p.next = -1;
+
+    /* pairs of hex digits or '?' wildcards, optionally space separated */
+    for (i = 0; i < n; ) {
+        if (isspace((unsigned char)text[i])) {
+            i++;
+            continue;
+        }
+        if (i + 1 >= n)
+            goto invalid;
+        hi = text[i] == '?' ? -2 : hex_nibble(text[i]);
+        lo = text[i+1] == '?' ? -2 : hex_nibble(text[i+1]);
+        if (hi == -1 || lo == -1)
+            goto invalid;
+
+        p.value[p.len] = (hi < 0 ? 0 : hi << 4) | (lo < 0 ? 0 : lo);
+        p.mask[p.len] = (hi < 0 ? 0 : 0xf0) | (lo < 0 ? 0 : 0x0f);
+        sprintf(p.text + p.len * 3, "%c%c ", hi < 0 ? '?' : tolower(text[i]),
+                lo < 0 ? '?' : tolower(text[i+1]));
+
+        /* keep track of the longest run of fixed bytes */
+        run = p.mask[p.len] == 0xff ? run + 1 : 0;
+        if (run > p.anchor_len) {
+            p.anchor_len = run;
+            p.anchor = p.len + 1 - run;
+        }
+        p.len++;
+        i += 2;
+    }
+    if (p.len == 0)
+        goto invalid;
+    p.text[p.len * 3 - 1] = '\0';
+
+    s->patterns = (struct search_pattern *)change_dynamic_memory(
+                      (char *)s->patterns,
+                      sizeof(*s->patterns) * (s->npatterns + 1));
+    s->patterns[s->npatterns++] = p;
+    if (p.len > s->max_len)
+        s->max_len = p.len;
+    return 0;
+
+invalid:
+    free(p.value);
+    free(p.mask);
+    free(p.text);
+    return -1;
+}
+
+static int new_state(struct searcher *s)
+{
+    int state = s->nstates++;
+
+    s->delta = (int *)change_dynamic_memory((char *)s->delta,
+                                            sizeof(int) * 256 * s->nstates);
+    s->output = (int *)change_dynamic_memory((char *)s->output,
+                                             sizeof(int) * s->nstates);
+    s->dict = (int *)change_dynamic_memory((char *)s->dict,
+                                           sizeof(int) * s->nstates);
+    s->depth = (int *)change_dynamic_memory((char *)s->depth,
+                                            sizeof(int) * s->nstates);
+    memset(s->delta + 256 * state, 0xff, sizeof(int) * 256);
+    s->output[state] = -1;
+    s->dict[state] = 0;
+    s->depth[state] = 0;
+    return state;
+}
+
+void searcher_compile(struct searcher *s)
+{
+    struct search_pattern *p;
+    int *queue, *fail;
+    int i, c, state, next, head = 0, tail = 0;
+    size_t k;
+
+    new_state(s);
+
+    /* build the trie of anchor factors, patterns with identical factors
+     * are chained together on the same final state.
+     */
+    for (i = 0; i < s->npatterns; i++) {
+        p = &s->patterns[i];
+        if (p->anchor_len == 0) {
+            s->unanchored = (int *)change_dynamic_memory(
+                                (char *)s->unanchored,
+                                sizeof(int) * (s->nunanchored + 1));
+            s->unanchored[s->nunanchored++] = i;
+            continue;
+        }
+        /* index the first two bytes of the factor, or flag its only byte */
+        if (p->anchor_len == 1) {
+            s->single[p->value[p->anchor]] = 1;
+        } else {
+            c = p->value[p->anchor] << 8 | p->value[p->anchor + 1];
+            s->pairs[c >> 3] |= 1 << (c & 7);
+        }
+        state = 0;
+        for (k = 0; k < p->anchor_len; k++) {
+            c = p->value[p->anchor + k];
+            if (s->delta[256 * state + c] < 0) {
+                next = new_state(s);
+                s->delta[256 * state + c] = next;
+                s->depth[next] = k + 1;
+            }
+            state = s->delta[256 * state + c];
+        }
+        p->next = s->output[state];
+        s->output[state] = i;
+    }
+
+    /* breadth-first traversal computing failure links, and turning the trie
+     * into a complete automaton.
+     */
+    queue = (int *)allocate_dynamic_memory(sizeof(int) * s->nstates);
+    fail = (int *)allocate_dynamic_memory(sizeof(int) * s->nstates);
+    for (c = 0; c < 256; c++) {
+        next = s->delta[c];
+        if (next < 0) {
+            s->delta[c] = 0;
+        } else {
+            fail[next] = 0;
+            queue[tail++] = next;
+            s->first[c] = 1 + s->single[c];
+            if (s->nfirst < (int)sizeof(s->first_bytes))
+                s->first_bytes[s->nfirst] = c;
+            s->nfirst++;
+        }
+    }
+    while (head < tail) {
+        state = queue[head++];
+        /* closest state down the failure chain with an output */
+        s->dict[state] = s->output[fail[state]] >= 0 ? fail[state]
+                                                     : s->dict[fail[state]];
+        for (c = 0; c < 256; c++) {
+            next = s->delta[256 * state + c];
+            if (next < 0) {
+                s->delta[256 * state + c] = s->delta[256 * fail[state] + c];
+            } else {
+                fail[next] = s->delta[256 * fail[state] + c];
+                queue[tail++] = next;
+            }
+        }
+    }
+
+    free(queue);
+    free(fail);
+}
+
+void searcher_free(struct searcher *s)
+{
+    int i;
+
+    for (i = 0; i < s->npatterns; i++) {
+        free(s->patterns[i].value);
+        free(s->patterns[i].mask);
+        free(s->patterns[i].text);
+    }
+    free(s->patterns);
+    free(s->delta);
+    free(s->output);
+    free(s->dict);
+    free(s->depth);
+    free(s->unanchored);
+    searcher_init(s);
+}
+
+static int pattern_matches(const struct search_pattern *p,
+                           const unsigned char *data)
+{
+    size_t i;
+
+    for (i = 0; i < p->len; i++) {
+        if ((data[i] & p->mask[i]) != p->value[i])
+            return 0;
+    }
+    return 1;
+}
+
+static void add_hit(struct search_job *job, int index,
+                    unsigned long long offset, int pattern)
+{
+    if (job->nhits[index] == job->capacity[index]) {
+        job->capacity[index] = job->capacity[index] ?
+                               job->capacity[index] * 2 : HITS_INITIAL_SIZE;
+        job->hits[index] = (struct search_hit *)change_dynamic_memory(
+                               (char *)job->hits[index],
+                               sizeof(struct search_hit) *
+                               job->capacity[index]);
+    }
+    job->hits[index][job->nhits[index]].offset = offset;
+    job->hits[index][job->nhits[index]].pattern = pattern;
+    job->nhits[index]++;
+}
+
+static int starts_factor(const struct searcher *s, const unsigned char *p)
+{
+    /* whether a factor of two bytes or more starts with p[0] and p[1] */
+    unsigned int pair = p[0] << 8 | p[1];
+
+    return s->pairs[pair >> 3] & (1 << (pair & 7));
+}
+
+static size_t skip_to_candidate(const struct searcher *s,
+                                const unsigned char *data, size_t i,
+                                size_t end)
+{
+    const unsigned char *p;
+
+    /* a single first byte: memchr() is vectorized by the C library */
+    if (s->nfirst == 1) {
+        p = memchr(data + i, s->first_bytes[0], end - i);
+        return p == NULL ? end : (size_t)(p - data);
+    }
+
+#ifdef __SSE2__
+    /* a few first bytes: compare 16 bytes at a time against each of them */
+    if (s->nfirst <= (int)sizeof(s->first_bytes)) {
+        __m128i needles[sizeof(s->first_bytes)];
+        int k, mask;
+
+        for (k = 0; k < s->nfirst; k++)
+            needles[k] = _mm_set1_epi8((char)s->first_bytes[k]);
+        for (; i + 16 <= end; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+            __m128i m = _mm_cmpeq_epi8(v, needles[0]);
+
+            for (k = 1; k < s->nfirst; k++)
+                m = _mm_or_si128(m, _mm_cmpeq_epi8(v, needles[k]));
+            mask = _mm_movemask_epi8(m);
+            if (mask != 0)
+                return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    /* many first bytes: look up pairs of bytes starting a factor */
+    for (; i + 1 < end; i++) {
+        if (s->first[data[i]] > 1 || starts_factor(s, data + i))
+            return i;
+    }
+    while (i < end && s->first[data[i]] == 0)
+        i++;
+    return i;
+}
+
+static void search_worker(void *ctx, int index, int nthreads)
+{
+    struct search_job *job = ctx;
+    const struct searcher *s = job->s;
+    const struct search_pattern *p;
+    size_t begin = job->size * index / nthreads;
+    size_t end = job->size * (index + 1) / nthreads;
+    size_t scan_end, i, start;
+    int k, state = 0, out;
+
+    /* matches must start in [begin, end) but may extend past 'end' */
+    scan_end = end + s->max_len - 1 < job->size ? end + s->max_len - 1
+                                                : job->size;
+
+    if (s->nstates > 1) {
+        for (i = begin; i < scan_end; i++) {
+            /* a lone pending byte which doesn't start a longer factor with
+             * the current one is as good as the root state.
+             */
+            if (s->depth[state] == 1 && !starts_factor(s, job->data + i - 1))
+                state = 0;
+            if (state == 0) {
+                i = skip_to_candidate(s, job->data, i, scan_end);
+                if (i >= scan_end)
+                    break;
+            }
+            state = s->delta[256 * state + job->data[i]];
+
+            /* every factor ending at 'i', then verify the whole patterns */
+            for (out = s->output[state] >= 0 ? state : s->dict[state];
+                 out != 0; out = s->dict[out]) {
+                for (k = s->output[out]; k >= 0; k = s->patterns[k].next) {
+                    p = &s->patterns[k];
+                    if (i + 1 < p->anchor + p->anchor_len)
+                        continue;
+                    start = i + 1 - p->anchor_len - p->anchor;
+                    if (start < begin || start >= end ||
+                        start + p->len > job->size)
+                        continue;
+                    if (pattern_matches(p, job->data + start))
+                        add_hit(job, index, start, k);
+                }
+            }
+        }
+    }
+
+    /* patterns made only of wildcards are tried at every offset */
+    for (k = 0; k < s->nunanchored; k++) {
+        p = &s->patterns[s->unanchored[k]];
+        for (i = begin; i < end && i + p->len <= job->size; i++) {
+            if (pattern_matches(p, job->data + i))
+                add_hit(job, index, i, s->unanchored[k]);
+        }
+    }
+}
+
+static int compare_hits(const void *a, const void *b)
+{
+    const struct search_hit *x = a, *y = b;
+
+    if (x->offset != y->offset)
+        return x->offset < y->offset ? -1 : 1;
+    return x->pattern - y->pattern;
+}
+
+size_t search_buffer(const struct searcher *s, const unsigned char *data,
+                     size_t size, int nthreads, struct search_hit **hits)
+{
+    struct search_job job;
+    size_t total = 0;
+    int i;
+
+    memset(&job, 0, sizeof(job));
+    job.s = s;
+    job.data = data;
+    job.size = size;
+
+    /* slices no smaller than the longest pattern */
+    if (nthreads > 1 && size / nthreads < s->max_len)
+        nthreads = 1;
+    run_threads(search_worker, &job, nthreads);
+
+    /* concatenate the sorted hits of every slice */
+    for (i = 0; i < nthreads; i++)
+        total += job.nhits[i];
+    *hits = (struct search_hit *)allocate_dynamic_memory(
+                sizeof(struct search_hit) * (total ? total : 1));
+    total = 0;
+    for (i = 0; i < nthreads; i++) {
+        if (job.nhits[i] == 0)
+            continue;
+        qsort(job.hits[i], job.nhits[i], sizeof(struct search_hit),
+              compare_hits);
+        memcpy(*hits + total, job.hits[i],
+               sizeof(struct search_hit) * job.nhits[i]);
+        total += job.nhits[i];
+        free(job.hits[i]);
+    }
+
+    return total;
+}
@@ -0,0 +1,212 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * sparse.c - byte runs and holes detection
+ *
+ * Memory dumps and disk images are mostly made of zero pages, payloads are
+ * padded with NOP sleds and filler characters. Runs of zero bytes are
+ * located by looking for a first zero byte with memchr(). Runs of any byte
+ * long enough span a whole aligned 16 bytes block, which are tested for
+ * being made of a single byte, the run being then extended both ways. Runs
+ * are measured 64 bytes at a time, with SSE2 when available.
+ *
+ * Holes of sparse files are known to read as zeros: they are looked up with
+ * SEEK_HOLE and SEEK_DATA and skipped without touching their pages.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/input.h"
+#include "include/sparse.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define RUN_BLOCK_SIZE      16      /* bytes of a block tested at once */
+
+void run_scanner_init(struct run_scanner *rs, const struct input_map *map,
+                      size_t min, int any_byte)
+{
+    rs->map = map;
+    rs->min = min > 1 ? min : 2;
+    rs->any_byte = any_byte;
+    rs->holes = 0;
+    input_next_hole(map, 0, &rs->hole_start, &rs->hole_end);
+}
+
+size_t byte_run_length(const unsigned char *data, size_t len,
+                       unsigned char byte)
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i b = _mm_set1_epi8((char)byte);
+
+    /* whole cache lines first, then 16 bytes at a time */
+    for (; i + 64 <= len; i += 64) {
+        __m128i v = _mm_and_si128(
+            _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i)),
+                               b),
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i +
+                                                                 16)), b)),
+            _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i +
+                                                                 32)), b),
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i +
+                                                                 48)), b)));
+
+        if (_mm_movemask_epi8(v) != 0xffff)
+            break;
+    }
+    for (; i + 16 <= len; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+                       _mm_loadu_si128((const __m128i *)(data + i)), b));
+
+        if (mask != 0xffff)
+            return i + __builtin_ctz(~mask);
+    }
+#endif
+    while (i < len && data[i] == byte)
+        i++;
+    return i;
+}
+
+static void update_hole(struct run_scanner *rs, size_t pos)
+{
+    if (pos >= rs->hole_end && rs->hole_end < rs->map->size)
+        input_next_hole(rs->map, pos, &rs->hole_start, &rs->hole_end);
+}
+
+static size_t zero_length(struct run_scanner *rs, size_t pos)
+{
+    const struct input_map *map = rs->map;
+    size_t start = pos;
+
+    /* zeros up to the next hole, then the hole itself, and so on */
+    while (pos < map->size) {
+        update_hole(rs, pos);
+        if (pos >= rs->hole_start && pos < rs->hole_end) {
+            rs->holes += rs->hole_end - pos;
+            pos = rs->hole_end;
+            continue;
+        }
+        pos += byte_run_length(map->data + pos, (pos < rs->hole_start ?
+                                                 rs->hole_start :
+                                                 map->size) - pos, 0);
+        if (pos < map->size && pos != rs->hole_start)
+            break;
+    }
+    return pos - start;
+}
+
+static size_t find_run(const struct run_scanner *rs, size_t pos, size_t end,
+                       size_t *len)
+{
+    const unsigned char *data = rs->map->data;
+    size_t b, start, n;
+
+    /* short runs don't always span a block, every byte is looked at */
+    if (rs->min < 2 * RUN_BLOCK_SIZE - 1) {
+        for (; pos < end; pos += n) {
+            n = 1 + byte_run_length(data + pos + 1, end - pos - 1,
+                                    data[pos]);
+            if (n >= rs->min) {
+                *len = n;
+                return pos;
+            }
+        }
+        return end;
+    }
+
+    b = (pos + RUN_BLOCK_SIZE - 1) & ~(size_t)(RUN_BLOCK_SIZE - 1);
+    while (b + RUN_BLOCK_SIZE <= end) {
+        if (byte_run_length(data + b + 1, RUN_BLOCK_SIZE - 1, data[b]) <
+            RUN_BLOCK_SIZE - 1) {
+            b += RUN_BLOCK_SIZE;
+            continue;
+        }
+        /* a block of a single byte, as part of a run as long as can be */
+        for (start = b; start > pos && data[start - 1] == data[b]; start--)
+            ;
+        n = b - start + byte_run_length(data + b, end - b, data[b]);
+        if (n >= rs->min) {
+            *len = n;
+            return start;
+        }
+        b = (start + n + RUN_BLOCK_SIZE - 1) &
+            ~(size_t)(RUN_BLOCK_SIZE - 1);
+    }
+    return end;
+}
+
+int next_byte_run(struct run_scanner *rs, size_t pos, struct byte_run *run)
+{
+    const struct input_map *map = rs->map;
+    const unsigned char *p;
+    unsigned long long holes;
+    size_t end, n;
+
+    while (pos < map->size) {
+        update_hole(rs, pos);
+        end = pos < rs->hole_start ? rs->hole_start : map->size;
+
+        /* a run of any byte up to the next hole, a zero run may go on
+         * through it.
+         */
+        if (rs->any_byte && pos < end) {
+            size_t from = pos;
+
+            pos = find_run(rs, pos, end, &n);
+            if (pos < end && (map->data[pos] != 0 || pos + n < end)) {
+                run->start = pos;
+                run->end = pos + n;
+                run->byte = map->data[pos];
+                return 1;
+            }
+            /* zeros right before a hole are part of its run */
+            while (pos == end && pos > from && map->data[pos - 1] == 0)
+                end = --pos;
+        }
+        /* every zero byte may start a zero run, holes start one */
+        if (rs->any_byte == 0 && pos < end) {
+            p = memchr(map->data + pos, 0, end - pos);
+            pos = p != NULL ? (size_t)(p - map->data) : end;
+        }
+        if (pos == map->size)
+            break;
+
+        holes = rs->holes;
+        n = zero_length(rs, pos);
+        if (n >= rs->min) {
+            run->start = pos;
+            run->end = pos + n;
+            run->byte = 0;
+            return 1;
+        }
+        /* holes of short runs are output as they read */
+        rs->holes = holes;
+        pos += n;
+    }
+    run->start = run->end = map->size;
+    run->byte = 0;
+    return 0;
+}
@@ -0,0 +1,247 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * strscan.c - printable strings scanner
+ *
+ * The input is classified 64 bytes at a time into bitmasks of printable and
+ * null bytes (with SSE2 when available). Strings are then found by walking
+ * the transitions of these masks, so long printable or binary stretches cost
+ * a single mask comparison per block.
+ *
+ * Strings are found when they close, an ASCII string possibly closing
+ * before a UTF-16LE string starting ahead of it. They are held back, in
+ * order of their start, until no open string starts before them, so they are
+ * reported in order of their offsets.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "include/alloc.h"
+#include "include/strscan.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define BLOCK_SIZE  64              /* bytes classified per bitmask */
+
+/* even and odd byte positions of a block, the two possible alignments of
+ * UTF-16LE characters.
+ */
+#define EVEN_POSITIONS  0x5555555555555555ULL
+#define ODD_POSITIONS   0xaaaaaaaaaaaaaaaaULL
+
+/* state of a string being tracked across blocks */
+struct run {
+    int open;                   /* a string is in progress */
+    size_t start;               /* offset of its first byte */
+};
+
+/* a string found, waiting for the strings starting before it */
+struct hit {
+    size_t start;
+    size_t end;
+    int encoding;
+};
+
+struct scan_context {
+    const unsigned char *data;
+    const struct strscan *scan;
+    struct hit *hits;           /* found strings, by increasing start */
+    size_t nhits;
+    size_t size;                /* capacity of 'hits' */
+};
+
+static int is_printable(unsigned char c)
+{
+    /* same character class as strings(1): printable ASCII and tab */
+    return (c >= 0x20 && c <= 0x7e) || c == '\t';
+}
+
+static uint64_t classify_block(const unsigned char *p, size_t n,
+                               uint64_t *zeros)
+{
+    uint64_t printable = 0, nulls = 0;
+    size_t i;
+
+#ifdef __SSE2__
+    if (n == BLOCK_SIZE) {
+        const __m128i below = _mm_set1_epi8(0x1f);
+        const __m128i above = _mm_set1_epi8(0x7f);
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i zero = _mm_setzero_si128();
+
+        for (i = 0; i < BLOCK_SIZE; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+            /* signed compares: bytes above 0x7f are negative and fail the
+             * lower bound check.
+             */
+            __m128i m = _mm_and_si128(_mm_cmpgt_epi8(v, below),
+                                      _mm_cmplt_epi8(v, above));
+
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, tab));
+            printable |= (uint64_t)(uint16_t)_mm_movemask_epi8(m) << i;
+            nulls |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+                         _mm_cmpeq_epi8(v, zero)) << i;
+        }
+        *zeros = nulls;
+        return printable;
+    }
+#endif
+
+    /* scalar path, also used for the trailing partial block */
+    for (i = 0; i < n; i++) {
+        if (is_printable(p[i]))
+            printable |= 1ULL << i;
+        if (p[i] == 0)
+            nulls |= 1ULL << i;
+    }
+    *zeros = nulls;
+    return printable;
+}
+
+static void report(struct scan_context *sc, size_t start, size_t end,
+                   int encoding)
+{
+    size_t chars = end - start, i;
+
+    if (encoding == STRSCAN_UTF16LE)
+        chars /= 2;
+    if (chars < sc->scan->min_length)
+        return;
+
+    if (sc->nhits == sc->size) {
+        sc->size = sc->size ? sc->size * 2 : 16;
+        sc->hits = (struct hit *)change_dynamic_memory((char *)sc->hits,
+                       sc->size * sizeof(struct hit));
+    }
+    /* strings mostly close in order of their start, insertion is cheap */
+    for (i = sc->nhits; i > 0 && sc->hits[i-1].start > start; i--)
+        sc->hits[i] = sc->hits[i-1];
+    sc->hits[i].start = start;
+    sc->hits[i].end = end;
+    sc->hits[i].encoding = encoding;
+    sc->nhits++;
+}
+
+static void release_hits(struct scan_context *sc, size_t before)
+{
+    size_t i, n;
+
+    /* strings starting before 'before' can't be preceded by another one */
+    for (n = 0; n < sc->nhits && sc->hits[n].start < before; n++) {
+        const struct hit *h = &sc->hits[n];
+
+        sc->scan->hit(sc->scan->ctx, h->start, sc->data + h->start,
+                      h->end - h->start, h->encoding);
+    }
+    for (i = n; i < sc->nhits; i++)
+        sc->hits[i-n] = sc->hits[i];
+    sc->nhits -= n;
+}
+
+static size_t open_start(const struct run *run, size_t size)
+{
+    return run->open ? run->start : size;
+}
+
+static void track_runs(struct scan_context *sc, struct run *run,
+                       uint64_t valid, uint64_t considered, size_t base,
+                       int encoding)
+{
+    uint64_t bits;
+    int k;
+
+    /* alternate between looking for the first valid and the first invalid
+     * considered position, which respectively open and close a string.
+     */
+    for (;;) {
+        if (run->open)
+            bits = ~valid & considered;
+        else
+            bits = valid & considered;
+        if (bits == 0)
+            return;
+
+        k = __builtin_ctzll(bits);
+        if (run->open) {
+            report(sc, run->start, base + k, encoding);
+            run->open = 0;
+        } else {
+            run->start = base + k;
+            run->open = 1;
+        }
+        /* drop positions up to and including 'k' */
+        considered &= ~((2ULL << k) - 1);
+    }
+}
+
+void scan_printable_strings(const unsigned char *data, size_t size,
+                            const struct strscan *scan)
+{
+    struct scan_context sc = { data, scan, NULL, 0, 0 };
+    struct run ascii = { 0, 0 };
+    struct run utf16[2] = { { 0, 0 }, { 0, 0 } };
+    size_t base;
+
+    for (base = 0; base < size; base += BLOCK_SIZE) {
+        size_t n = size - base < BLOCK_SIZE ? size - base : BLOCK_SIZE;
+        uint64_t limit = n == BLOCK_SIZE ? ~0ULL : (1ULL << n) - 1;
+        uint64_t zeros;
+        uint64_t printable = classify_block(data + base, n, &zeros);
+
+        if (scan->encodings & STRSCAN_ASCII)
+            track_runs(&sc, &ascii, printable, limit, base, STRSCAN_ASCII);
+
+        if (scan->encodings & STRSCAN_UTF16LE) {
+            /* a character is a printable byte followed by a null byte, the
+             * latter may be the first byte of the next block.
+             */
+            uint64_t next = base + BLOCK_SIZE < size &&
+                            data[base + BLOCK_SIZE] == 0;
+            uint64_t chars = printable & ((zeros >> 1) | (next << 63));
+
+            track_runs(&sc, &utf16[0], chars, limit & EVEN_POSITIONS, base,
+                       STRSCAN_UTF16LE);
+            track_runs(&sc, &utf16[1], chars, limit & ODD_POSITIONS, base,
+                       STRSCAN_UTF16LE);
+        }
+
+        /* report the strings no open string starts before */
+        if (sc.nhits > 0) {
+            size_t before = open_start(&ascii, size);
+
+            if (open_start(&utf16[0], size) < before)
+                before = open_start(&utf16[0], size);
+            if (open_start(&utf16[1], size) < before)
+                before = open_start(&utf16[1], size);
+            release_hits(&sc, before);
+        }
+    }
+
+    /* strings still open run up to the end of the input */
+    if (ascii.open)
+        report(&sc, ascii.start, size, STRSCAN_ASCII);
+    if (utf16[0].open)
+        report(&sc, utf16[0].start, size, STRSCAN_UTF16LE);
+    if (utf16[1].open)
+        report(&sc, utf16[1].start, size, STRSCAN_UTF16LE);
+    release_hits(&sc, size + 1);
+    free(sc.hits);
+}
@@ -0,0 +1,88 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * thread.c - worker threads helpers
+ *
+ * Data-parallel work is split by the callers into 'nthreads' slices, each
+ * processed by a worker function receiving its slice index. The calling
+ * thread processes the first slice itself.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "include/thread.h"
+
+struct thread_arg {
+    thread_fn fn;
+    void *ctx;
+    int index;
+    int nthreads;
+};
+
+static void * thread_start(void *arg)
+{
+    struct thread_arg *ta = arg;
+
+    ta->fn(ta->ctx, ta->index, ta->nthreads);
+    return NULL;
+}
+
+int default_thread_count(void)
+{
+    /* one worker per online processor */
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (n < 1)
+        return 1;
+    if (n > MAX_THREADS)
+        return MAX_THREADS;
+    return (int)n;
+}
+
+void run_threads(thread_fn fn, void *ctx, int nthreads)
+{
+    pthread_t threads[MAX_THREADS];
+    struct thread_arg args[MAX_THREADS];
+    int i, started;
+
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+
+    /* spawn workers for slices 1..n-1, slice 0 runs in the caller */
+    for (started = 1; started < nthreads; started++) {
+        args[started].fn = fn;
+        args[started].ctx = ctx;
+        args[started].index = started;
+        args[started].nthreads = nthreads;
+        if (pthread_create(&threads[started], NULL, thread_start,
+                           &args[started]) != 0) {
+            printf("Error: cannot create worker thread.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    fn(ctx, 0, nthreads);
+
+    for (i = 1; i < started; i++)
+        pthread_join(threads[i], NULL);
+}
@@ -0,0 +1,105 @@
+/* vi:set tw=78 ts=8 sw=4 sts=4 et:
+ *
+ * This file is part of Binary String Toolkit.
+ *
+ * Copyright (C) 2018 Nicolas Chabbey
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * watch.c - input file change notification
+ *
+ * The directory of the file is watched rather than the file itself: editors
+ * and build tools often write a new file and rename it over the old one,
+ * which a watch on the old inode would never report. A change is a file of
+ * that name being closed after writing, or moved in place.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include "include/alloc.h"
+#include "include/watch.h"
+
+/* room for a batch of events, names included */
+#define WATCH_EVENTS_SIZE   (64 * (sizeof(struct inotify_event) + 256))
+
+void watch_open(struct watch *w, const char *filename)
+{
+    const char *slash = strrchr(filename, '/');
+    char *dir;
+
+    /* split the path between the directory and the file name */
+    if (slash == NULL) {
+        dir = allocate_dynamic_memory(2);
+        strcpy(dir, ".");
+        slash = filename - 1;
+    } else {
+        dir = allocate_dynamic_memory(slash - filename + 2);
+        memcpy(dir, filename, slash - filename + 1);
+        dir[slash - filename + 1] = '\0';
+    }
+    w->name = allocate_dynamic_memory(strlen(slash + 1) + 1);
+    strcpy(w->name, slash + 1);
+
+    w->fd = inotify_init1(IN_CLOEXEC);
+    if (w->fd < 0) {
+        perror("inotify_init1");
+        exit(EXIT_FAILURE);
+    }
+    w->wd = inotify_add_watch(w->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (w->wd < 0) {
+        printf("Error: directory \"%s\" cannot be watched.\n", dir);
+        exit(EXIT_FAILURE);
+    }
+    free(dir);
+}
+
+void watch_wait(struct watch *w)
+{
+    char *events = allocate_dynamic_memory(WATCH_EVENTS_SIZE);
+    int changed = 0;
+
+    /* block until the file changed, other files of the directory are
+     * ignored. events queued together are handled as a single change.
+     */
+    while (!changed) {
+        ssize_t n = read(w->fd, events, WATCH_EVENTS_SIZE);
+        char *p;
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            perror("read");
+            exit(EXIT_FAILURE);
+        }
+        for (p = events; p < events + n;) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+
+            if (ev->len > 0 && strcmp(ev->name, w->name) == 0)
+                changed = 1;
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    free(events);
+}
+
+void watch_close(struct watch *w)
+{
+    close(w->fd);
+    free(w->name);
+    w->name = NULL;
+}